@@ -62,23 +62,22 @@
 #include "adler32_simd.h"
 #endif
 
-/* ========================================================================= */
-uLong ZEXPORT adler32_z(uLong adler, const Bytef *buf, z_size_t len) {
-    unsigned long sum2;
-    unsigned n;
-    /* TODO(cavalcantii): verify if this lengths are optimal for current CPUs. */
 #if defined(ADLER32_SIMD_SSSE3) || defined(ADLER32_SIMD_NEON) \
     || defined(ADLER32_SIMD_RVV)
-#if defined(ADLER32_SIMD_SSSE3)
-    if (buf != Z_NULL && len >= 64 && x86_cpu_enable_ssse3)
-#elif defined(ADLER32_SIMD_NEON)
-    if (buf != Z_NULL && len >= 64)
-#elif defined(ADLER32_SIMD_RVV)
-    if (buf != Z_NULL && len >= 32 && riscv_cpu_enable_rvv)
-#endif
-        return adler32_simd_(adler, buf, len);
+#  define ADLER32_DISPATCH
+/* TODO(cavalcantii): verify if this lengths are optimal for current CPUs. */
+#  if defined(ADLER32_SIMD_RVV)
+#    define ADLER32_SIMD_MIN_LENGTH 32
+#  else
+#    define ADLER32_SIMD_MIN_LENGTH 64
+#  endif
 #endif
 
+/* ========================================================================= */
+local uLong adler32_generic(uLong adler, const Bytef *buf, z_size_t len) {
+    unsigned long sum2;
+    unsigned n;
+
     /* split Adler-32 into component sums */
     sum2 = (adler >> 16) & 0xffff;
     adler &= 0xffff;
@@ -157,11 +156,73 @@ uLong ZEXPORT adler32_z(uLong adler, const Bytef *buf, z_size_t len) {
     return adler | (sum2 << 16);
 }
 
+#ifdef ADLER32_DISPATCH
+local uLong adler32_simd(uLong adler, const Bytef *buf, z_size_t len) {
+    return adler32_simd_(adler, buf, len);
+}
+#endif
+
+/* ========================================================================= */
+uLong ZEXPORT adler32_z(uLong adler, const Bytef *buf, z_size_t len) {
+#ifdef ADLER32_DISPATCH
+    if (buf != Z_NULL && len >= ADLER32_SIMD_MIN_LENGTH)
+        return cpu_kernels.adler32_fn(adler, buf, len);
+#endif
+    return adler32_generic(adler, buf, len);
+}
+
 /* ========================================================================= */
 uLong ZEXPORT adler32(uLong adler, const Bytef *buf, uInt len) {
     return adler32_z(adler, buf, len);
 }
 
+/* ========================================================================= */
+local uLong adler32_copy_generic(uLong adler, Bytef *dst, const Bytef *src,
+                                 z_size_t len) {
+    zmemcpy(dst, src, len);
+    return adler32_z(adler, dst, len);
+}
+
+#if defined(ADLER32_SIMD_SSSE3) || defined(ADLER32_SIMD_NEON)
+local uLong adler32_copy_simd(uLong adler, Bytef *dst, const Bytef *src,
+                              z_size_t len) {
+    return adler32_copy_simd_(adler, dst, src, len);
+}
+#endif
+
+/* ========================================================================= */
+/* Copies len bytes from src to dst and returns the Adler-32 of them, updating
+ * adler. With SIMD the checksum is computed from the vectors being copied, so
+ * the data is read once instead of twice; used by deflate's read_buf(). */
+uLong ZLIB_INTERNAL adler32_copy(uLong adler, Bytef *dst, const Bytef *src,
+                                 z_size_t len) {
+#ifdef ADLER32_DISPATCH
+    if (len >= ADLER32_SIMD_MIN_LENGTH)
+        return cpu_kernels.adler32_copy_fn(adler, dst, src, len);
+#endif
+    return adler32_copy_generic(adler, dst, src, len);
+}
+
+/* ========================================================================= */
+void ZLIB_INTERNAL adler32_select_kernels(struct cpu_kernels_s *kernels) {
+    kernels->adler32_fn = adler32_generic;
+    kernels->adler32_copy_fn = adler32_copy_generic;
+#if defined(ADLER32_SIMD_SSSE3)
+    if (x86_cpu_enable_ssse3) {
+        kernels->adler32_fn = adler32_simd;
+        kernels->adler32_copy_fn = adler32_copy_simd;
+    }
+#elif defined(ADLER32_SIMD_NEON)
+    if (cpu_max_tier >= CPU_TIER_SSSE3) {
+        kernels->adler32_fn = adler32_simd;
+        kernels->adler32_copy_fn = adler32_copy_simd;
+    }
+#elif defined(ADLER32_SIMD_RVV)
+    if (riscv_cpu_enable_rvv)
+        kernels->adler32_fn = adler32_simd;
+#endif
+}
+
 /* ========================================================================= */
 local uLong adler32_combine_(uLong adler1, uLong adler2, z_off64_t len2) {
     unsigned long sum1;
@@ -53,8 +53,15 @@
 
 #include <tmmintrin.h>
 
-uint32_t ZLIB_INTERNAL adler32_simd_(  /* SSSE3 */
+#include "cpu_features.h"
+
+/* Computes the Adler-32 of buf, and copies buf to dst too if dst is not NULL.
+ * The copy stores the vectors the checksum loads, so costs no extra reads.
+ */
+TARGET_SSSE3
+static inline uint32_t adler32_ssse3(  /* SSSE3 */
     uint32_t adler,
+    unsigned char *dst,
     const unsigned char *buf,
     z_size_t len)
 {
@@ -103,6 +110,12 @@ uint32_t ZLIB_INTERNAL adler32_simd_(  /* SSSE3 */
             const __m128i bytes1 = _mm_loadu_si128((__m128i*)(buf));
             const __m128i bytes2 = _mm_loadu_si128((__m128i*)(buf + 16));
 
+            if (dst) {
+                _mm_storeu_si128((__m128i*)(dst), bytes1);
+                _mm_storeu_si128((__m128i*)(dst + 16), bytes2);
+                dst += BLOCK_SIZE;
+            }
+
             /*
              * Add previous block byte sum to v_ps.
              */
@@ -157,6 +170,9 @@ uint32_t ZLIB_INTERNAL adler32_simd_(  /* SSSE3 */
      * Handle leftover data.
      */
     if (len) {
+        if (dst)
+            zmemcpy(dst, buf, len);
+
         if (len >= 16) {
             s2 += (s1 += *buf++);
             s2 += (s1 += *buf++);
@@ -196,12 +212,35 @@ uint32_t ZLIB_INTERNAL adler32_simd_(  /* SSSE3 */
     return s1 | (s2 << 16);
 }
 
+TARGET_SSSE3
+uint32_t ZLIB_INTERNAL adler32_simd_(
+    uint32_t adler,
+    const unsigned char *buf,
+    z_size_t len)
+{
+    return adler32_ssse3(adler, NULL, buf, len);
+}
+
+TARGET_SSSE3
+uint32_t ZLIB_INTERNAL adler32_copy_simd_(
+    uint32_t adler,
+    unsigned char *dst,
+    const unsigned char *buf,
+    z_size_t len)
+{
+    return adler32_ssse3(adler, dst, buf, len);
+}
+
 #elif defined(ADLER32_SIMD_NEON)
 
 #include <arm_neon.h>
 
-uint32_t ZLIB_INTERNAL adler32_simd_(  /* NEON */
+/* Computes the Adler-32 of buf, and copies buf to dst too if dst is not NULL.
+ * The copy stores the vectors the checksum loads, so costs no extra reads.
+ */
+static inline uint32_t adler32_neon(  /* NEON */
     uint32_t adler,
+    unsigned char *dst,
     const unsigned char *buf,
     z_size_t len)
 {
@@ -216,6 +255,8 @@ uint32_t ZLIB_INTERNAL adler32_simd_(  /* NEON */
      */
     if ((uintptr_t)buf & 15) {
         while ((uintptr_t)buf & 15) {
+            if (dst)
+                *dst++ = *buf;
             s2 += (s1 += *buf++);
             --len;
         }
@@ -259,6 +300,12 @@ uint32_t ZLIB_INTERNAL adler32_simd_(  /* NEON */
             const uint8x16_t bytes1 = vld1q_u8((uint8_t*)(buf));
             const uint8x16_t bytes2 = vld1q_u8((uint8_t*)(buf + 16));
 
+            if (dst) {
+                vst1q_u8((uint8_t*)(dst), bytes1);
+                vst1q_u8((uint8_t*)(dst + 16), bytes2);
+                dst += BLOCK_SIZE;
+            }
+
             /*
              * Add previous block byte sum to v_s2.
              */
@@ -324,6 +371,9 @@ uint32_t ZLIB_INTERNAL adler32_simd_(  /* NEON */
      * Handle leftover data.
      */
     if (len) {
+        if (dst)
+            zmemcpy(dst, buf, len);
+
         if (len >= 16) {
             s2 += (s1 += *buf++);
             s2 += (s1 += *buf++);
@@ -363,6 +413,23 @@ uint32_t ZLIB_INTERNAL adler32_simd_(  /* NEON */
     return s1 | (s2 << 16);
 }
 
+uint32_t ZLIB_INTERNAL adler32_simd_(
+    uint32_t adler,
+    const unsigned char *buf,
+    z_size_t len)
+{
+    return adler32_neon(adler, NULL, buf, len);
+}
+
+uint32_t ZLIB_INTERNAL adler32_copy_simd_(
+    uint32_t adler,
+    unsigned char *dst,
+    const unsigned char *buf,
+    z_size_t len)
+{
+    return adler32_neon(adler, dst, buf, len);
+}
+
 #elif defined(ADLER32_SIMD_RVV)
 #include <riscv_vector.h>
 
@@ -14,3 +14,10 @@ uint32_t ZLIB_INTERNAL adler32_simd_(
     uint32_t adler,
     const unsigned char *buf,
     z_size_t len);
+
+/* adler32_simd_() of src, copying src to dst in the same pass. */
+uint32_t ZLIB_INTERNAL adler32_copy_simd_(
+    uint32_t adler,
+    unsigned char *dst,
+    const unsigned char *src,
+    z_size_t len);
@@ -57,7 +57,9 @@
 #define deflateBound Cr_z_deflateBound
 #define deflateCopy Cr_z_deflateCopy
 #define deflateEnd Cr_z_deflateEnd
+#define deflateEstimate Cr_z_deflateEstimate
 #define deflateGetDictionary Cr_z_deflateGetDictionary
+#define deflateGetStats Cr_z_deflateGetStats
 /* #undef deflateInit */
 /* #undef deflateInit2 */
 #define deflateInit2_ Cr_z_deflateInit2_
@@ -89,6 +91,7 @@
 #define gzfwrite Cr_z_gzfwrite
 #define gzgetc Cr_z_gzgetc
 #define gzgetc_ Cr_z_gzgetc_
+#define gzgetline Cr_z_gzgetline
 #define gzgets Cr_z_gzgets
 #define gzoffset Cr_z_gzoffset
 #define gzoffset64 Cr_z_gzoffset64
@@ -97,7 +100,9 @@
 #define gzopen_w Cr_z_gzopen_w
 #define gzprintf Cr_z_gzprintf
 #define gzputc Cr_z_gzputc
+#define gzputint Cr_z_gzputint
 #define gzputs Cr_z_gzputs
+#define gzputtime Cr_z_gzputtime
 #define gzread Cr_z_gzread
 #define gzrewind Cr_z_gzrewind
 #define gzseek Cr_z_gzseek
@@ -117,6 +122,7 @@
 #define inflateCopy Cr_z_inflateCopy
 #define inflateEnd Cr_z_inflateEnd
 #define inflateGetDictionary Cr_z_inflateGetDictionary
+#define inflateGetStats Cr_z_inflateGetStats
 #define inflateGetHeader Cr_z_inflateGetHeader
 /* #undef inflateInit */
 /* #undef inflateInit2 */
@@ -138,8 +144,11 @@
 #define uncompress Cr_z_uncompress
 #define uncompress2 Cr_z_uncompress2
 #define zError Cr_z_zError
+#define zallocGetStats Cr_z_zallocGetStats
+#define zallocTracked Cr_z_zallocTracked
 #define zcalloc Cr_z_zcalloc
 #define zcfree Cr_z_zcfree
+#define zfreeTracked Cr_z_zfreeTracked
 #define zlibCompileFlags Cr_z_zlibCompileFlags
 #define zlibVersion Cr_z_zlibVersion
 /* #undef Byte */
@@ -180,6 +189,8 @@
 #define x86_cpu_enable_simd Cr_z_x86_cpu_enable_simd
 
 /* Symbols added by adler_simd.c */
+#define adler32_copy Cr_z_adler32_copy
+#define adler32_copy_simd_ Cr_z_adler32_copy_simd_
 #define adler32_simd_ Cr_z_adler32_simd_
 #define x86_cpu_enable_ssse3 Cr_z_x86_cpu_enable_ssse3
 
@@ -199,5 +210,10 @@
 /* Symbols added by cpu_features.c */
 #define cpu_check_features Cr_z_cpu_check_features
 #define x86_cpu_enable_sse2 Cr_z_x86_cpu_enable_sse2
+#define cpu_max_tier Cr_z_cpu_max_tier
+#define cpu_set_max_tier Cr_z_cpu_set_max_tier
+#define cpu_kernels Cr_z_cpu_kernels
+#define crc32_select_kernels Cr_z_crc32_select_kernels
+#define adler32_select_kernels Cr_z_adler32_select_kernels
 
 #endif /* THIRD_PARTY_ZLIB_CHROMECONF_H_ */
@@ -12,6 +12,43 @@
  * it with the [raw] argument. Use the [gzip] [zlib] arguments to select those
  * stream wrappers.
  *
+ * Streaming mode (--stream) feeds the input to deflate() and inflate() in
+ * chunks of --chunk bytes, using an output buffer of --out bytes and the
+ * --flush mode for each compressed chunk. It reports the compress/uncompress
+ * rates and the per-call latency distribution of deflate() and inflate().
+ *
+ * Thread scaling mode (--threads N) runs independent compress and uncompress
+ * loops on 1, 2, 4, ... N threads, each thread pinned to a CPU core where the
+ * platform supports it. It reports the aggregate and per-thread rates, and the
+ * scaling efficiency relative to 1 thread. Use --csv for the scaling curve.
+ *
+ * Small message mode (--messages size) chops the input into messages of size
+ * bytes and measures the per-message latency of a complete deflateInit2() +
+ * deflate() + deflateEnd() and inflateInit2() + inflate() + inflateEnd(), and
+ * of the same work on a stream reused with deflateReset() / inflateReset().
+ * It reports the p50/p90/p99/p99.9 latencies in nanoseconds.
+ *
+ * On Linux, --perf reads hardware performance counters (perf_event_open) over
+ * the compress and uncompress loops, and reports cycles/byte, instructions/
+ * byte, IPC, and branch, L1 data and last level cache misses per KB. With
+ * --csv the counters are appended to the CSV fields. --perf applies to the
+ * default mode only, and is rejected with --stream, --threads, --messages and
+ * --kernels.
+ *
+ * Kernel mode (--kernels) runs crc32, adler32, compress (slide_hash) and
+ * uncompress (inflate chunk copy) at each SIMD kernel tier: scalar, SSSE3,
+ * SSE4.2+PCLMUL and AVX-512, capping the tier in-process. It needs a zlib
+ * built with the SIMD optimizations and linked statically (the tier override
+ * is internal to zlib), see ZLIB_BENCH_CPU_TIERS. The ZLIB_CPU_MAX_TIER
+ * environment variable caps the tier in any zlib build.
+ *
+ * Memory mode (--memory) allocates the zlib streams with zallocTracked(), and
+ * reports the peak bytes used by a deflate stream, by a one-shot inflate (the
+ * timed inflate, which writes straight to the output and never allocates the
+ * window), by a streaming inflate (which does), and the peak RSS of the
+ * process. Use --window and --memlevel to vary the deflate and
+ * inflate windowBits (9..15) and the deflate memLevel (1..9).
+ *
  * Note this code can be compiled outside of the Chromium build system against
  * the system zlib (-lz) with g++ or clang++ as follows:
  *
@@ -19,10 +56,12 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <fstream>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <memory.h>
@@ -30,8 +69,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include "zlib.h"
 
+#if defined(ZLIB_BENCH_CPU_TIERS)
+extern "C" {
+#include "cpu_features.h"
+}
+#endif
+
 void error_exit(const char* error, int code) {
   fprintf(stderr, "%s (%d)\n", error, code);
   exit(code);
@@ -75,6 +133,9 @@ size_t zlib_estimate_compressed_size(size_t input_size) {
   return compressBound(input_size);
 }
 
+static int zlib_window_bits = MAX_WBITS;
+static int zlib_mem_level = MAX_MEM_LEVEL;
+
 enum zlib_wrapper {
   kWrapperNONE,
   kWrapperZLIB,
@@ -84,11 +145,11 @@ enum zlib_wrapper {
 
 inline int zlib_stream_wrapper_type(zlib_wrapper type) {
   if (type == kWrapperZLIB) // zlib DEFLATE stream wrapper
-    return MAX_WBITS;
+    return zlib_window_bits;
   if (type == kWrapperGZIP) // gzip DEFLATE stream wrapper
-    return MAX_WBITS + 16;
+    return zlib_window_bits + 16;
   if (type == kWrapperZRAW) // no wrapper, use raw DEFLATE
-    return -MAX_WBITS;
+    return -zlib_window_bits;
   error_exit("bad wrapper type", int(type));
   return 0;
 }
@@ -121,6 +182,210 @@ const char* zlib_level_strategy_name(int compression_level) {
 
 static int zlib_compression_level = Z_DEFAULT_COMPRESSION;
 
+static bool zlib_memory_stats = false;
+static std::atomic<size_t> deflate_peak_memory(0);
+static std::atomic<size_t> inflate_peak_memory(0);
+static std::atomic<size_t> inflate_stream_peak_memory(0);
+
+// Sets |stream| to account for its memory usage in |stats|, if --memory.
+void zlib_track_memory(z_stream* stream, z_alloc_stats* stats) {
+  if (!zlib_memory_stats)
+    return;
+  memset(stats, 0, sizeof(*stats));
+  stream->zalloc = zallocTracked;
+  stream->zfree = zfreeTracked;
+  stream->opaque = stats;
+}
+
+void zlib_record_memory(const z_alloc_stats& stats,
+                        std::atomic<size_t>* peak) {
+  if (!zlib_memory_stats)
+    return;
+  size_t value = peak->load();
+  while (value < stats.peak && !peak->compare_exchange_weak(value, stats.peak))
+    ;
+}
+
+// Returns the peak resident set size of the process in KB, or -1.
+long peak_rss_kb() {
+#if !defined(_WIN32)
+  struct rusage usage;
+  if (!getrusage(RUSAGE_SELF, &usage)) {
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;  // bytes
+#else
+    return usage.ru_maxrss;
+#endif
+  }
+#endif
+  return -1;
+}
+
+static bool zlib_stream_mode = false;
+static size_t zlib_stream_chunk = 16 * 1024;
+static size_t zlib_stream_out = 16 * 1024;
+static int zlib_stream_flush = Z_SYNC_FLUSH;
+
+static int zlib_threads = 0;
+
+static size_t zlib_message_size = 0;
+
+static bool zlib_perf_counters = false;
+
+static bool zlib_kernels_mode = false;
+
+enum perf_event {
+  kPerfCycles,
+  kPerfInstructions,
+  kPerfBranchMisses,
+  kPerfL1DMisses,
+  kPerfLLCMisses,
+  kPerfEvents,
+};
+
+/*
+ * Hardware performance counters of the calling thread. The counters are opened
+ * as one group, led by the cycles counter, so that they are scheduled on the
+ * PMU together and count over the same time; if the kernel multiplexes the
+ * group, each interval is scaled by its time enabled / time running. The
+ * counters are accumulated over each start() / stop() interval. A counter that
+ * cannot be opened (no kernel support, or perf_event_paranoid), or whose group
+ * never ran, reads as -1.
+ */
+struct PerfCounters {
+  PerfCounters() {
+    for (int i = 0; i < kPerfEvents; ++i) {
+      fd[i] = -1;
+      slot[i] = -1;
+      count[i] = 0;
+    }
+    slots = 0;
+    ran = false;
+#if defined(__linux__)
+    static const struct {
+      uint32_t type;
+      uint64_t config;
+    } events[kPerfEvents] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+      {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                           (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    };
+    for (int i = 0; i < kPerfEvents; ++i) {
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = events[i].type;
+      attr.config = events[i].config;
+      attr.disabled = i == kPerfCycles;  // The members follow the leader.
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1,
+                           i == kPerfCycles ? -1 : fd[kPerfCycles], 0);
+      if (fd[i] >= 0)
+        slot[i] = slots++;
+      else if (i == kPerfCycles)
+        break;  // No leader, no group.
+    }
+#endif
+  }
+
+  ~PerfCounters() {
+#if defined(__linux__)
+    for (int i = 0; i < kPerfEvents; ++i)
+      if (fd[i] >= 0)
+        close(fd[i]);
+#endif
+  }
+
+  void start() {
+#if defined(__linux__)
+    if (fd[kPerfCycles] < 0)
+      return;
+    ioctl(fd[kPerfCycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fd[kPerfCycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+  }
+
+  void stop() {
+#if defined(__linux__)
+    if (fd[kPerfCycles] < 0)
+      return;
+    ioctl(fd[kPerfCycles], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    // PERF_FORMAT_GROUP: nr, time_enabled, time_running, then the values.
+    uint64_t data[3 + kPerfEvents];
+    const ssize_t expected = (ssize_t)((3 + slots) * sizeof(uint64_t));
+    if (read(fd[kPerfCycles], data, sizeof(data)) != expected || data[2] == 0)
+      return;
+    const double scale = double(data[1]) / double(data[2]);
+    for (int i = 0; i < kPerfEvents; ++i)
+      if (slot[i] >= 0)
+        count[i] += double(data[3 + slot[i]]) * scale;
+    ran = true;
+#endif
+  }
+
+  double value(perf_event event) const {
+    return fd[event] >= 0 && ran ? count[event] : -1;
+  }
+
+  int fd[kPerfEvents];
+  int slot[kPerfEvents];  // Index of the counter in a group read.
+  int slots;
+  bool ran;
+  double count[kPerfEvents];
+};
+
+// Counter |event| per |unit| bytes of |bytes|, or -1 if not available.
+double perf_per_bytes(const PerfCounters& perf,
+                      perf_event event,
+                      double bytes,
+                      double unit) {
+  const double value = perf.value(event);
+  return value < 0 ? -1 : value * unit / bytes;
+}
+
+double perf_ipc(const PerfCounters& perf) {
+  const double cycles = perf.value(kPerfCycles);
+  const double instructions = perf.value(kPerfInstructions);
+  return (cycles > 0 && instructions >= 0) ? instructions / cycles : -1;
+}
+
+void print_perf(const char* phase, const PerfCounters& perf, double bytes) {
+  printf("  perf %-6s cycles/B %.2f instr/B %.2f IPC %.2f"
+         " br-miss/KB %.2f L1D-miss/KB %.2f LLC-miss/KB %.2f\n", phase,
+         perf_per_bytes(perf, kPerfCycles, bytes, 1),
+         perf_per_bytes(perf, kPerfInstructions, bytes, 1), perf_ipc(perf),
+         perf_per_bytes(perf, kPerfBranchMisses, bytes, 1024),
+         perf_per_bytes(perf, kPerfL1DMisses, bytes, 1024),
+         perf_per_bytes(perf, kPerfLLCMisses, bytes, 1024));
+}
+
+void csv_perf(const PerfCounters& perf, double bytes) {
+  printf("\t%.4lf\t%.4lf\t%.4lf\t%.4lf\t%.4lf\t%.4lf",
+         perf_per_bytes(perf, kPerfCycles, bytes, 1),
+         perf_per_bytes(perf, kPerfInstructions, bytes, 1), perf_ipc(perf),
+         perf_per_bytes(perf, kPerfBranchMisses, bytes, 1024),
+         perf_per_bytes(perf, kPerfL1DMisses, bytes, 1024),
+         perf_per_bytes(perf, kPerfLLCMisses, bytes, 1024));
+}
+
+const char* zlib_flush_name(int flush) {
+  if (flush == Z_NO_FLUSH)
+    return "none";
+  if (flush == Z_SYNC_FLUSH)
+    return "sync";
+  if (flush == Z_FULL_FLUSH)
+    return "full";
+  error_exit("bad flush mode", flush);
+  return nullptr;
+}
+
 void zlib_compress(
     const zlib_wrapper type,
     const char* input,
@@ -134,9 +399,11 @@ void zlib_compress(
 
   z_stream stream;
   memset(&stream, 0, sizeof(stream));
+  z_alloc_stats memory;
+  zlib_track_memory(&stream, &memory);
 
   int result = deflateInit2(&stream, zlib_compression_level, Z_DEFLATED,
-      zlib_stream_wrapper_type(type), MAX_MEM_LEVEL, zlib_strategy);
+      zlib_stream_wrapper_type(type), zlib_mem_level, zlib_strategy);
   if (result != Z_OK)
     error_exit("deflateInit2 failed", result);
 
@@ -153,6 +420,7 @@ void zlib_compress(
   result |= deflateEnd(&stream);
   if (result != Z_STREAM_END)
     error_exit("compress failed", result);
+  zlib_record_memory(memory, &deflate_peak_memory);
 
   if (resize_output)
     output->resize(output_size);
@@ -166,6 +434,8 @@ void zlib_uncompress(
 {
   z_stream stream;
   memset(&stream, 0, sizeof(stream));
+  z_alloc_stats memory;
+  zlib_track_memory(&stream, &memory);
 
   int result = inflateInit2(&stream, zlib_stream_wrapper_type(type));
   if (result != Z_OK)
@@ -180,6 +450,7 @@ void zlib_uncompress(
   if (stream.total_out != output_size)
     result = Z_DATA_ERROR;
   result |= inflateEnd(&stream);
+  zlib_record_memory(memory, &inflate_peak_memory);
   if (result == Z_STREAM_END)
     return;
 
@@ -189,6 +460,48 @@ void zlib_uncompress(
   error_exit(error.c_str(), result);
 }
 
+// Inflates |input| into a small buffer, as a streaming reader would, so that
+// inflate() allocates its window, and records the peak memory used, if
+// --memory. Not timed: zlib_uncompress() inflates in one shot for speed.
+void zlib_uncompress_memory(
+    const zlib_wrapper type,
+    const std::string& input,
+    const size_t output_size)
+{
+  if (!zlib_memory_stats)
+    return;
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  z_alloc_stats memory;
+  zlib_track_memory(&stream, &memory);
+
+  int result = inflateInit2(&stream, zlib_stream_wrapper_type(type));
+  if (result != Z_OK)
+    error_exit("inflateInit2 failed", result);
+
+  stream.next_in = (z_const Bytef*)input.data();
+  stream.avail_in = (uInt)input.size();
+
+  Bytef buffer[4096];
+  do {
+    stream.next_out = buffer;
+    stream.avail_out = sizeof(buffer);
+    result = inflate(&stream, Z_NO_FLUSH);
+  } while (result == Z_OK);
+  if (stream.total_out != output_size)
+    result = Z_DATA_ERROR;
+  result |= inflateEnd(&stream);
+  zlib_record_memory(memory, &inflate_stream_peak_memory);
+  if (result == Z_STREAM_END)
+    return;
+
+  std::string error("streaming uncompress failed: ");
+  if (stream.msg)
+    error.append(stream.msg);
+  error_exit(error.c_str(), result);
+}
+
 void verify_equal(const char* input, size_t size, std::string* output) {
   const char* data = string_data(output);
   if (output->size() == size && !memcmp(data, input, size))
@@ -236,6 +549,588 @@ void check_file(const Data& file, zlib_wrapper type, int mode) {
     error_exit("check file: error writing output", 3);
 }
 
+typedef std::chrono::steady_clock::time_point time_point;
+
+inline time_point time_now() {
+  return std::chrono::steady_clock::now();
+}
+
+inline double elapsed_ns(time_point start, time_point end) {
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// Returns the |p| percentile (0..100) of the sorted |samples|.
+double percentile(const std::vector<double>& samples, double p) {
+  if (samples.empty())
+    return 0;
+  size_t index = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+  return samples[std::min(index, samples.size() - 1)];
+}
+
+void zlib_stream_compress(
+    const zlib_wrapper type,
+    const char* input,
+    const size_t input_size,
+    std::string* output,
+    std::vector<double>* latency)
+{
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+
+  int result = deflateInit2(&stream, zlib_compression_level, Z_DEFLATED,
+      zlib_stream_wrapper_type(type), zlib_mem_level, zlib_strategy);
+  if (result != Z_OK)
+    error_exit("deflateInit2 failed", result);
+
+  std::vector<Bytef> buffer(zlib_stream_out);
+  output->clear();
+
+  size_t offset = 0;
+  do {
+    const size_t chunk = std::min(zlib_stream_chunk, input_size - offset);
+    const int flush =
+        (offset + chunk == input_size) ? Z_FINISH : zlib_stream_flush;
+    stream.next_in = (z_const Bytef*)input + offset;
+    stream.avail_in = (uInt)chunk;
+    offset += chunk;
+
+    // Call deflate() until the chunk is consumed and flushed: with an output
+    // buffer that is not full on return.
+    do {
+      stream.next_out = buffer.data();
+      stream.avail_out = (uInt)buffer.size();
+      const auto start = time_now();
+      result = deflate(&stream, flush);
+      latency->push_back(elapsed_ns(start, time_now()));
+      if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+        error_exit("stream compress failed", result);
+      output->append((char*)buffer.data(), buffer.size() - stream.avail_out);
+    } while (stream.avail_out == 0);
+
+    if (stream.avail_in > 0)
+      error_exit("stream compress: input was not consumed", Z_DATA_ERROR);
+  } while (offset < input_size);
+
+  if (result != Z_STREAM_END)
+    error_exit("stream compress: stream did not end", result);
+  deflateEnd(&stream);
+}
+
+void zlib_stream_uncompress(
+    const zlib_wrapper type,
+    const std::string& input,
+    std::string* output,
+    std::vector<double>* latency)
+{
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+
+  int result = inflateInit2(&stream, zlib_stream_wrapper_type(type));
+  if (result != Z_OK)
+    error_exit("inflateInit2 failed", result);
+
+  std::vector<Bytef> buffer(zlib_stream_out);
+  output->clear();
+
+  size_t offset = 0;
+  do {
+    const size_t chunk = std::min(zlib_stream_chunk, input.size() - offset);
+    stream.next_in = (z_const Bytef*)input.data() + offset;
+    stream.avail_in = (uInt)chunk;
+    offset += chunk;
+
+    do {
+      stream.next_out = buffer.data();
+      stream.avail_out = (uInt)buffer.size();
+      const auto start = time_now();
+      result = inflate(&stream, Z_NO_FLUSH);
+      latency->push_back(elapsed_ns(start, time_now()));
+      if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+        break;
+      output->append((char*)buffer.data(), buffer.size() - stream.avail_out);
+    } while (stream.avail_out == 0 && result != Z_STREAM_END);
+  } while (offset < input.size() && result != Z_STREAM_END &&
+           (result == Z_OK || result == Z_BUF_ERROR));
+
+  inflateEnd(&stream);
+  if (result == Z_STREAM_END)
+    return;
+
+  std::string error("stream uncompress failed: ");
+  if (stream.msg)
+    error.append(stream.msg);
+  error_exit(error.c_str(), result);
+}
+
+void print_latency(const char* name, std::vector<double>* latency) {
+  std::sort(latency->begin(), latency->end());
+  printf("  %s calls %zu latency us: p50 %.2f p90 %.2f p99 %.2f max %.2f\n",
+         name, latency->size(), percentile(*latency, 50) / 1000,
+         percentile(*latency, 90) / 1000, percentile(*latency, 99) / 1000,
+         latency->empty() ? 0 : latency->back() / 1000);
+}
+
+void zlib_stream_file(const struct Data& file,
+                      zlib_wrapper type,
+                      int width,
+                      bool output_csv_format) {
+  const size_t length = file.size;
+  const char* data = file.data.get();
+
+  /*
+   * Stream the whole file a few times with |repeats| to process about 10MB
+   * of data, as in zlib_file().
+   */
+  const int mega_byte = 1024 * 1024;
+  const int repeats = int((10 * mega_byte + length) / (length + 1));
+  const int runs = 5;
+  double ctime[runs];
+  double utime[runs];
+
+  std::string compressed;
+  std::string output;
+  std::vector<double> deflate_latency;
+  std::vector<double> inflate_latency;
+
+  for (int run = 0; run < runs; ++run) {
+    auto start = time_now();
+    for (int r = 0; r < repeats; ++r)
+      zlib_stream_compress(type, data, length, &compressed, &deflate_latency);
+    ctime[run] = elapsed_ns(start, time_now()) / 1e9;
+
+    start = time_now();
+    for (int r = 0; r < repeats; ++r)
+      zlib_stream_uncompress(type, compressed, &output, &inflate_latency);
+    utime[run] = elapsed_ns(start, time_now()) / 1e9;
+
+    verify_equal(data, length, &output);
+  }
+
+  std::sort(ctime, ctime + runs);
+  std::sort(utime, utime + runs);
+
+  const double megabytes = double(length) * repeats / mega_byte;
+  double deflate_rate_med = megabytes / ctime[runs / 2];
+  double inflate_rate_med = megabytes / utime[runs / 2];
+  double deflate_rate_max = megabytes / ctime[0];
+  double inflate_rate_max = megabytes / utime[0];
+  double compress_ratio = compressed.size() * 100.0 / length;
+
+  std::sort(deflate_latency.begin(), deflate_latency.end());
+  std::sort(inflate_latency.begin(), inflate_latency.end());
+
+  if (!output_csv_format) {
+    printf("%s: [s %zuK o %zuK %s] bytes %*zu -> %*zu %4.2f%%",
+           zlib_wrapper_name(type), zlib_stream_chunk / 1024,
+           zlib_stream_out / 1024, zlib_flush_name(zlib_stream_flush), width,
+           length, width, compressed.size(), compress_ratio);
+    printf(" comp %5.1f (%5.1f) MB/s uncomp %5.1f (%5.1f) MB/s\n",
+           deflate_rate_med, deflate_rate_max, inflate_rate_med,
+           inflate_rate_max);
+    print_latency("deflate", &deflate_latency);
+    print_latency("inflate", &inflate_latency);
+  } else {
+    printf("%s\t%.5lf\t%.5lf\t%.5lf\t%.5lf\t%.5lf", file.name.c_str(),
+           deflate_rate_med, inflate_rate_med, deflate_rate_max,
+           inflate_rate_max, compress_ratio);
+    printf("\t%.1lf\t%.1lf\t%.1lf\t%.1lf\t%.1lf\t%.1lf\n",
+           percentile(deflate_latency, 50), percentile(deflate_latency, 99),
+           deflate_latency.back(), percentile(inflate_latency, 50),
+           percentile(inflate_latency, 99), inflate_latency.back());
+  }
+}
+
+void pin_thread_to_cpu(int cpu) {
+#if defined(__linux__)
+  const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu % cpus, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  (void)cpu;
+#endif
+}
+
+struct ThreadResult {
+  double ctime;
+  double utime;
+  size_t output_length;
+};
+
+// Compresses then uncompresses the file data |repeats| times in 1MB blocks on
+// |threads| concurrent threads. The compress and uncompress phases are timed
+// separately, and each phase starts on all threads at the same time.
+void zlib_run_threads(const struct Data& file,
+                      zlib_wrapper type,
+                      int threads,
+                      int repeats,
+                      std::vector<ThreadResult>* results) {
+  const size_t block_size = 1 << 20;
+  const size_t blocks = (file.size + block_size - 1) / block_size;
+  const char* data = file.data.get();
+
+  std::vector<std::vector<std::string>> compressed(threads);
+  std::vector<std::vector<std::string>> output(threads);
+  results->assign(threads, ThreadResult());
+
+  for (int phase = 0; phase < 2; ++phase) {
+    std::atomic<int> ready(0);
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&, phase, t] {
+        pin_thread_to_cpu(t);
+        std::vector<std::string>& c = compressed[t];
+        std::vector<std::string>& u = output[t];
+        if (phase == 0) {
+          c.resize(blocks);
+          for (size_t b = 0; b < blocks; ++b)
+            c[b].resize(zlib_estimate_compressed_size(block_size));
+        } else {
+          u.resize(blocks);
+        }
+
+        ready.fetch_add(1);
+        while (ready.load() < threads)
+          std::this_thread::yield();
+
+        const auto start = time_now();
+        for (int r = 0; r < repeats; ++r) {
+          for (size_t b = 0; b < blocks; ++b) {
+            const size_t offset = b * block_size;
+            const size_t size = std::min(block_size, file.size - offset);
+            if (phase == 0) {
+              zlib_compress(type, data + offset, size, &c[b],
+                            r == repeats - 1);
+            } else {
+              u[b].resize(size);
+              zlib_uncompress(type, c[b], size, &u[b]);
+            }
+          }
+        }
+        const double seconds = elapsed_ns(start, time_now()) / 1e9;
+
+        ThreadResult& result = (*results)[t];
+        if (phase == 0) {
+          result.ctime = seconds;
+          result.output_length = 0;
+          for (size_t b = 0; b < blocks; ++b)
+            result.output_length += c[b].size();
+        } else {
+          result.utime = seconds;
+          for (size_t b = 0; b < blocks; ++b)
+            verify_equal(data + b * block_size, u[b].size(), &u[b]);
+        }
+      });
+    }
+
+    for (auto& worker : workers)
+      worker.join();
+  }
+}
+
+void zlib_threads_file(const struct Data& file,
+                       zlib_wrapper type,
+                       int width,
+                       bool output_csv_format) {
+  const size_t length = file.size;
+  const int mega_byte = 1024 * 1024;
+  const int repeats = int((10 * mega_byte + length) / (length + 1));
+  const double megabytes = double(length) * repeats / mega_byte;
+
+  // Sweep 1, 2, 4, ... threads, ending with |zlib_threads|.
+  std::vector<int> counts;
+  for (int n = 1; n < zlib_threads; n *= 2)
+    counts.push_back(n);
+  counts.push_back(zlib_threads);
+
+  double deflate_rate_one = 0;
+  double inflate_rate_one = 0;
+
+  for (int threads : counts) {
+    std::vector<ThreadResult> results;
+    zlib_run_threads(file, type, threads, repeats, &results);
+
+    // The aggregate rate is limited by the slowest thread.
+    double ctime = 0, utime = 0;
+    for (const ThreadResult& result : results) {
+      ctime = std::max(ctime, result.ctime);
+      utime = std::max(utime, result.utime);
+    }
+    const double deflate_rate = megabytes * threads / ctime;
+    const double inflate_rate = megabytes * threads / utime;
+    if (threads == 1) {
+      deflate_rate_one = deflate_rate;
+      inflate_rate_one = inflate_rate;
+    }
+    const double deflate_efficiency =
+        deflate_rate * 100.0 / (deflate_rate_one * threads);
+    const double inflate_efficiency =
+        inflate_rate * 100.0 / (inflate_rate_one * threads);
+    const double compress_ratio =
+        results[0].output_length * 100.0 / length;
+
+    if (!output_csv_format) {
+      printf("%s: [t %3d] bytes %*zu -> %*zu %4.2f%%",
+             zlib_wrapper_name(type), threads, width, length, width,
+             results[0].output_length, compress_ratio);
+      printf(" comp %7.1f MB/s %5.1f%% uncomp %7.1f MB/s %5.1f%%\n",
+             deflate_rate, deflate_efficiency, inflate_rate,
+             inflate_efficiency);
+      if (threads == 1)
+        continue;
+      printf("  per-thread comp/uncomp MB/s:");
+      for (const ThreadResult& result : results)
+        printf(" %.1f/%.1f", megabytes / result.ctime, megabytes / result.utime);
+      printf("\n");
+    } else {
+      printf("%s\t%d\t%.5lf\t%.5lf\t%.5lf\t%.5lf\t%.2lf\t%.2lf\t%.5lf\n",
+             file.name.c_str(), threads, deflate_rate, inflate_rate,
+             deflate_rate / threads, inflate_rate / threads,
+             deflate_efficiency, inflate_efficiency, compress_ratio);
+    }
+  }
+}
+
+void print_percentiles_ns(const char* name, std::vector<double>* latency) {
+  std::sort(latency->begin(), latency->end());
+  printf("  %-14s ns: p50 %8.0f p90 %8.0f p99 %8.0f p99.9 %8.0f\n", name,
+         percentile(*latency, 50), percentile(*latency, 90),
+         percentile(*latency, 99), percentile(*latency, 99.9));
+}
+
+void csv_percentiles_ns(std::vector<double>* latency) {
+  std::sort(latency->begin(), latency->end());
+  printf("\t%.0f\t%.0f\t%.0f\t%.0f", percentile(*latency, 50),
+         percentile(*latency, 90), percentile(*latency, 99),
+         percentile(*latency, 99.9));
+}
+
+// Compresses |input| into |output| using |stream|, which must be initialized
+// or reset. Returns the compressed size.
+size_t zlib_message_compress(z_stream* stream,
+                             const char* input,
+                             size_t input_size,
+                             std::string* output) {
+  stream->next_in = (z_const Bytef*)input;
+  stream->avail_in = (uInt)input_size;
+  stream->next_out = (Bytef*)string_data(output);
+  stream->avail_out = (uInt)output->size();
+  int result = deflate(stream, Z_FINISH);
+  if (result != Z_STREAM_END)
+    error_exit("message compress failed", result);
+  return output->size() - stream->avail_out;
+}
+
+void zlib_message_uncompress(z_stream* stream,
+                             const char* input,
+                             size_t input_size,
+                             std::string* output) {
+  stream->next_in = (z_const Bytef*)input;
+  stream->avail_in = (uInt)input_size;
+  stream->next_out = (Bytef*)string_data(output);
+  stream->avail_out = (uInt)output->size();
+  int result = inflate(stream, Z_FINISH);
+  if (result != Z_STREAM_END)
+    error_exit("message uncompress failed", result);
+}
+
+void zlib_messages_file(const struct Data& file,
+                        zlib_wrapper type,
+                        int width,
+                        bool output_csv_format) {
+  const size_t length = file.size;
+  const char* data = file.data.get();
+  const int window_bits = zlib_stream_wrapper_type(type);
+
+  /*
+   * Chop the data into messages, and cycle over them to measure at least
+   * |count| messages.
+   */
+  const size_t message_size = std::min(zlib_message_size, length);
+  const size_t messages = length / message_size;
+  const size_t count = std::max<size_t>(messages, 20000);
+
+  std::vector<double> deflate_init;
+  std::vector<double> deflate_reset;
+  std::vector<double> inflate_init;
+  std::vector<double> inflate_reset;
+
+  std::string compressed(zlib_estimate_compressed_size(message_size), 0);
+  std::string output(message_size, 0);
+  size_t output_length = 0;
+
+  z_stream dstream;
+  memset(&dstream, 0, sizeof(dstream));
+  int result = deflateInit2(&dstream, zlib_compression_level, Z_DEFLATED,
+      window_bits, zlib_mem_level, zlib_strategy);
+  if (result != Z_OK)
+    error_exit("deflateInit2 failed", result);
+
+  z_stream istream;
+  memset(&istream, 0, sizeof(istream));
+  result = inflateInit2(&istream, window_bits);
+  if (result != Z_OK)
+    error_exit("inflateInit2 failed", result);
+
+  for (size_t m = 0; m < count; ++m) {
+    const char* message = data + (m % messages) * message_size;
+
+    // Full init + compress + end.
+    auto start = time_now();
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    result = deflateInit2(&stream, zlib_compression_level, Z_DEFLATED,
+        window_bits, zlib_mem_level, zlib_strategy);
+    if (result != Z_OK)
+      error_exit("deflateInit2 failed", result);
+    size_t size = zlib_message_compress(&stream, message, message_size,
+                                        &compressed);
+    deflateEnd(&stream);
+    deflate_init.push_back(elapsed_ns(start, time_now()));
+
+    // Reset + compress.
+    start = time_now();
+    deflateReset(&dstream);
+    zlib_message_compress(&dstream, message, message_size, &compressed);
+    deflate_reset.push_back(elapsed_ns(start, time_now()));
+
+    // Full init + uncompress + end.
+    start = time_now();
+    memset(&stream, 0, sizeof(stream));
+    result = inflateInit2(&stream, window_bits);
+    if (result != Z_OK)
+      error_exit("inflateInit2 failed", result);
+    zlib_message_uncompress(&stream, compressed.data(), size, &output);
+    inflateEnd(&stream);
+    inflate_init.push_back(elapsed_ns(start, time_now()));
+
+    // Reset + uncompress.
+    start = time_now();
+    inflateReset(&istream);
+    zlib_message_uncompress(&istream, compressed.data(), size, &output);
+    inflate_reset.push_back(elapsed_ns(start, time_now()));
+
+    verify_equal(message, message_size, &output);
+    if (m < messages)
+      output_length += size;
+  }
+
+  deflateEnd(&dstream);
+  inflateEnd(&istream);
+
+  const size_t input_length = messages * message_size;
+  const double compress_ratio = output_length * 100.0 / input_length;
+
+  if (!output_csv_format) {
+    printf("%s: [m %zu] bytes %*zu -> %*zu %4.2f%% messages %zu\n",
+           zlib_wrapper_name(type), message_size, width, input_length, width,
+           output_length, compress_ratio, count);
+    print_percentiles_ns("deflate init", &deflate_init);
+    print_percentiles_ns("deflate reset", &deflate_reset);
+    print_percentiles_ns("inflate init", &inflate_init);
+    print_percentiles_ns("inflate reset", &inflate_reset);
+  } else {
+    printf("%s\t%zu\t%.5lf", file.name.c_str(), message_size, compress_ratio);
+    csv_percentiles_ns(&deflate_init);
+    csv_percentiles_ns(&deflate_reset);
+    csv_percentiles_ns(&inflate_init);
+    csv_percentiles_ns(&inflate_reset);
+    printf("\n");
+  }
+}
+
+#if defined(ZLIB_BENCH_CPU_TIERS)
+// Returns the best of 5 runs rate in MB/s of |function| processing |bytes|.
+template <typename Function>
+double best_rate(double bytes, Function function) {
+  double best = 0;
+  for (int run = 0; run < 5; ++run) {
+    const auto start = time_now();
+    function();
+    const double seconds = elapsed_ns(start, time_now()) / 1e9;
+    best = std::max(best, bytes / (1024 * 1024) / seconds);
+  }
+  return best;
+}
+
+void zlib_kernels_file(const struct Data& file,
+                       zlib_wrapper type,
+                       bool output_csv_format) {
+  static const char* const tiers[] = {"scalar", "ssse3", "sse42", "avx512"};
+
+  const size_t length = file.size;
+  const char* data = file.data.get();
+  const Bytef* bytes = (const Bytef*)data;
+  const int mega_byte = 1024 * 1024;
+  const int repeats = int((10 * mega_byte + length) / (length + 1));
+  const double total_bytes = double(length) * repeats;
+
+  const size_t block_size = 1 << 20;
+  const size_t blocks = (length + block_size - 1) / block_size;
+  std::vector<std::string> compressed(blocks);
+  std::vector<std::string> output(blocks);
+
+  if (!output_csv_format) {
+    printf("%-8s %10s %10s %10s %10s  (MB/s)\n", "tier", "crc32", "adler32",
+           "comp", "uncomp");
+  }
+
+  for (int tier = CPU_TIER_SCALAR; tier <= CPU_TIER_MAX; ++tier) {
+    if (cpu_set_max_tier(tier) != tier) {
+      if (!output_csv_format)
+        printf("%-8s not supported by this CPU or build\n", tiers[tier]);
+      continue;
+    }
+
+    volatile uLong check = 0;
+    const double crc_rate = best_rate(total_bytes, [&] {
+      for (int r = 0; r < repeats; ++r)
+        check = crc32_z(check, bytes, length);
+    });
+    const double adler_rate = best_rate(total_bytes, [&] {
+      for (int r = 0; r < repeats; ++r)
+        check = adler32_z(check, bytes, length);
+    });
+
+    for (size_t b = 0; b < blocks; ++b) {
+      const size_t offset = b * block_size;
+      const size_t size = std::min(block_size, length - offset);
+      zlib_compress(type, data + offset, size, &compressed[b], true);
+      output[b].resize(size);
+    }
+    const double deflate_rate = best_rate(total_bytes, [&] {
+      for (int r = 0; r < repeats; ++r) {
+        for (size_t b = 0; b < blocks; ++b) {
+          const size_t offset = b * block_size;
+          const size_t size = std::min(block_size, length - offset);
+          zlib_compress(type, data + offset, size, &compressed[b],
+                        r == repeats - 1);
+        }
+      }
+    });
+    const double inflate_rate = best_rate(total_bytes, [&] {
+      for (int r = 0; r < repeats; ++r)
+        for (size_t b = 0; b < blocks; ++b)
+          zlib_uncompress(type, compressed[b], output[b].size(), &output[b]);
+    });
+    for (size_t b = 0; b < blocks; ++b)
+      verify_equal(data + b * block_size, output[b].size(), &output[b]);
+
+    if (!output_csv_format) {
+      printf("%-8s %10.1f %10.1f %10.1f %10.1f\n", tiers[tier], crc_rate,
+             adler_rate, deflate_rate, inflate_rate);
+    } else {
+      printf("%s\t%s\t%.5lf\t%.5lf\t%.5lf\t%.5lf\n", file.name.c_str(),
+             tiers[tier], crc_rate, adler_rate, deflate_rate, inflate_rate);
+    }
+  }
+
+  cpu_set_max_tier(CPU_TIER_MAX);
+}
+#endif
+
 void zlib_file(const char* name,
                zlib_wrapper type,
                int width,
@@ -257,6 +1152,10 @@ void zlib_file(const char* name,
     return;
   }
 
+  deflate_peak_memory = 0;
+  inflate_peak_memory = 0;
+  inflate_stream_peak_memory = 0;
+
   /*
    * Report compression strategy and file name.
    */
@@ -265,6 +1164,28 @@ void zlib_file(const char* name,
     printf("%s%-40s :\n", strategy, name);
   }
 
+#if defined(ZLIB_BENCH_CPU_TIERS)
+  if (zlib_kernels_mode) {
+    zlib_kernels_file(file, type, output_csv_format);
+    return;
+  }
+#endif
+
+  if (zlib_message_size) {
+    zlib_messages_file(file, type, width, output_csv_format);
+    return;
+  }
+
+  if (zlib_threads) {
+    zlib_threads_file(file, type, width, output_csv_format);
+    return;
+  }
+
+  if (zlib_stream_mode) {
+    zlib_stream_file(file, type, width, output_csv_format);
+    return;
+  }
+
   /*
    * Chop the data into blocks.
    */
@@ -294,6 +1215,14 @@ void zlib_file(const char* name,
   double ctime[runs];
   double utime[runs];
 
+  // Opened only with --perf: each set is several perf_event_open() calls.
+  std::unique_ptr<PerfCounters> cperf;
+  std::unique_ptr<PerfCounters> uperf;
+  if (zlib_perf_counters) {
+    cperf.reset(new PerfCounters);
+    uperf.reset(new PerfCounters);
+  }
+
   for (int run = 0; run < runs; ++run) {
     const auto now = [] { return std::chrono::steady_clock::now(); };
 
@@ -301,11 +1230,15 @@ void zlib_file(const char* name,
     for (int b = 0; b < blocks; ++b)
       compressed[b].resize(zlib_estimate_compressed_size(block_size));
 
+    if (cperf)
+      cperf->start();
     auto start = now();
     for (int b = 0; b < blocks; ++b)
       for (int r = 0; r < repeats; ++r)
         zlib_compress(type, input[b], input_length[b], &compressed[b]);
     ctime[run] = std::chrono::duration<double>(now() - start).count();
+    if (cperf)
+      cperf->stop();
 
     // Compress again, resizing compressed, so we don't leave junk at the
     // end of the compressed string that could confuse zlib_uncompress().
@@ -315,14 +1248,21 @@ void zlib_file(const char* name,
     for (int b = 0; b < blocks; ++b)
       output[b].resize(input_length[b]);
 
+    if (uperf)
+      uperf->start();
     start = now();
     for (int r = 0; r < repeats; ++r)
       for (int b = 0; b < blocks; ++b)
         zlib_uncompress(type, compressed[b], input_length[b], &output[b]);
     utime[run] = std::chrono::duration<double>(now() - start).count();
+    if (uperf)
+      uperf->stop();
 
     for (int b = 0; b < blocks; ++b)
       verify_equal(input[b], input_length[b], &output[b]);
+
+    for (int b = 0; b < blocks; ++b)
+      zlib_uncompress_memory(type, compressed[b], input_length[b]);
   }
 
   /*
@@ -342,6 +1282,9 @@ void zlib_file(const char* name,
   inflate_rate_max = length * repeats / mega_byte / utime[0];
   double compress_ratio = output_length * 100.0 / length;
 
+  // Bytes of input data processed while the perf counters were running.
+  const double perf_bytes = double(length) * repeats * runs;
+
   if (!output_csv_format) {
     // type, block size, compression ratio, etc
     printf("%s: [b %dM] bytes %*d -> %*u %4.2f%%", zlib_wrapper_name(type),
@@ -352,10 +1295,34 @@ void zlib_file(const char* name,
     printf(" comp %5.1f (%5.1f) MB/s uncomp %5.1f (%5.1f) MB/s\n",
            deflate_rate_med, deflate_rate_max, inflate_rate_med,
            inflate_rate_max);
+
+    if (zlib_perf_counters) {
+      print_perf("comp", *cperf, perf_bytes);
+      print_perf("uncomp", *uperf, perf_bytes);
+    }
+
+    if (zlib_memory_stats) {
+      printf("  memory [w %d m %d] deflate %zu bytes inflate %zu bytes"
+             " (one-shot %zu bytes) peak RSS %ld KB\n", zlib_window_bits,
+             zlib_mem_level, deflate_peak_memory.load(),
+             inflate_stream_peak_memory.load(), inflate_peak_memory.load(),
+             peak_rss_kb());
+    }
   } else {
-    printf("%s\t%.5lf\t%.5lf\t%.5lf\t%.5lf\t%.5lf\n", name, deflate_rate_med,
+    printf("%s\t%.5lf\t%.5lf\t%.5lf\t%.5lf\t%.5lf", name, deflate_rate_med,
            inflate_rate_med, deflate_rate_max, inflate_rate_max,
            compress_ratio);
+    if (zlib_perf_counters) {
+      csv_perf(*cperf, perf_bytes);
+      csv_perf(*uperf, perf_bytes);
+    }
+    if (zlib_memory_stats) {
+      printf("\t%d\t%d\t%zu\t%zu\t%zu\t%ld", zlib_window_bits,
+             zlib_mem_level, deflate_peak_memory.load(),
+             inflate_stream_peak_memory.load(), inflate_peak_memory.load(),
+             peak_rss_kb());
+    }
+    printf("\n");
   }
 }
 
@@ -377,11 +1344,40 @@ void get_field_width(int argc, char* argv[], int& value) {
   value = atoi(argv[argn++]);
 }
 
+bool get_size(int argc, char* argv[], size_t& value) {
+  if (argn >= argc || !isdigit(argv[argn][0]))
+    return false;
+  char* end;
+  value = strtoul(argv[argn++], &end, 10);
+  if (*end == 'k' || *end == 'K')
+    value <<= 10, ++end;
+  else if (*end == 'm' || *end == 'M')
+    value <<= 20, ++end;
+  return !*end && value > 0 && value <= (1u << 30);
+}
+
+bool get_flush(int argc, char* argv[], int& value) {
+  if (argn >= argc)
+    return false;
+  const char* name = argv[argn++];
+  if (!strcmp(name, "none"))
+    value = Z_NO_FLUSH;
+  else if (!strcmp(name, "sync"))
+    value = Z_SYNC_FLUSH;
+  else if (!strcmp(name, "full"))
+    value = Z_FULL_FLUSH;
+  else
+    return false;
+  return true;
+}
+
 void usage_exit(const char* program) {
   static auto* options =
       "gzip|zlib|raw"
       " [--compression 0:9] [--huffman|--rle] [--field width] [--check]"
-      " [--csv]";
+      " [--csv] [--stream [--chunk size] [--out size]"
+      " [--flush none|sync|full]] [--threads N] [--messages size] [--perf]"
+      " [--kernels] [--memory [--window 9:15] [--memlevel 1:9]]";
   printf("usage: %s %s files ...\n", program, options);
   printf("zlib version: %s\n", ZLIB_VERSION);
   exit(1);
@@ -417,9 +1413,40 @@ int main(int argc, char* argv[]) {
       get_field_width(argc, argv, size_field_width);
     } else if (get_option(argc, argv, "--csv")) {
       output_csv = true;
-      printf(
-          "filename\tcompression\tdecompression\tcomp_max\t"
-          "decomp_max\tcompress_ratio\n");
+    } else if (get_option(argc, argv, "--stream")) {
+      zlib_stream_mode = true;
+    } else if (get_option(argc, argv, "--chunk")) {
+      if (!get_size(argc, argv, zlib_stream_chunk))
+        usage_exit(argv[0]);
+    } else if (get_option(argc, argv, "--out")) {
+      if (!get_size(argc, argv, zlib_stream_out))
+        usage_exit(argv[0]);
+    } else if (get_option(argc, argv, "--flush")) {
+      if (!get_flush(argc, argv, zlib_stream_flush))
+        usage_exit(argv[0]);
+    } else if (get_option(argc, argv, "--kernels")) {
+#if !defined(ZLIB_BENCH_CPU_TIERS)
+      error_exit("--kernels: not supported by this zlib_bench build", 1);
+#endif
+      zlib_kernels_mode = true;
+    } else if (get_option(argc, argv, "--memory")) {
+      zlib_memory_stats = true;
+    } else if (get_option(argc, argv, "--window")) {
+      if (argn >= argc || (zlib_window_bits = atoi(argv[argn++])) < 9 ||
+          zlib_window_bits > MAX_WBITS)
+        usage_exit(argv[0]);
+    } else if (get_option(argc, argv, "--memlevel")) {
+      if (argn >= argc || (zlib_mem_level = atoi(argv[argn++])) < 1 ||
+          zlib_mem_level > MAX_MEM_LEVEL)
+        usage_exit(argv[0]);
+    } else if (get_option(argc, argv, "--perf")) {
+      zlib_perf_counters = true;
+    } else if (get_option(argc, argv, "--messages")) {
+      if (!get_size(argc, argv, zlib_message_size))
+        usage_exit(argv[0]);
+    } else if (get_option(argc, argv, "--threads")) {
+      if (argn >= argc || (zlib_threads = atoi(argv[argn++])) <= 0)
+        usage_exit(argv[0]);
     } else {
       usage_exit(argv[0]);
     }
@@ -428,6 +1455,53 @@ int main(int argc, char* argv[]) {
   if (argn >= argc)
     usage_exit(argv[0]);
 
+  if (zlib_perf_counters &&
+      (zlib_stream_mode || zlib_threads || zlib_message_size ||
+       zlib_kernels_mode)) {
+    error_exit("--perf: not supported with --stream, --threads, --messages"
+               " or --kernels", 1);
+  }
+
+  if (output_csv && zlib_kernels_mode) {
+    printf("filename\ttier\tcrc32\tadler32\tcompression\tdecompression\n");
+  } else if (output_csv && zlib_message_size) {
+    printf("filename\tmessage_size\tcompress_ratio");
+    for (const char* name : {"deflate_init", "deflate_reset", "inflate_init",
+                             "inflate_reset"}) {
+      printf("\t%s_p50_ns\t%s_p90_ns\t%s_p99_ns\t%s_p999_ns", name, name,
+             name, name);
+    }
+    printf("\n");
+  } else if (output_csv && zlib_threads) {
+    printf(
+        "filename\tthreads\tcompression\tdecompression\tcomp_per_thread\t"
+        "decomp_per_thread\tcomp_efficiency\tdecomp_efficiency\t"
+        "compress_ratio\n");
+  } else if (output_csv) {
+    printf(
+        "filename\tcompression\tdecompression\tcomp_max\t"
+        "decomp_max\tcompress_ratio");
+    if (zlib_stream_mode) {
+      printf(
+          "\tdeflate_p50_ns\tdeflate_p99_ns\tdeflate_max_ns"
+          "\tinflate_p50_ns\tinflate_p99_ns\tinflate_max_ns");
+    } else if (zlib_perf_counters) {
+      for (const char* phase : {"comp", "decomp"}) {
+        printf(
+            "\t%s_cycles_per_byte\t%s_instructions_per_byte\t%s_ipc"
+            "\t%s_branch_misses_per_kb\t%s_l1d_misses_per_kb"
+            "\t%s_llc_misses_per_kb", phase, phase, phase, phase, phase,
+            phase);
+      }
+    }
+    if (zlib_memory_stats && !zlib_stream_mode) {
+      printf(
+          "\twindow_bits\tmem_level\tdeflate_peak_bytes"
+          "\tinflate_peak_bytes\tinflate_oneshot_peak_bytes\tpeak_rss_kb");
+    }
+    printf("\n");
+  }
+
   if (size_field_width < 6)
     size_field_width = 6;
   while (argn < argc) {
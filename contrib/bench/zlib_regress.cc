@@ -0,0 +1,941 @@
+/*
+ * Copyright 2026 The Chromium Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the Chromium source repository LICENSE file.
+ *
+ * A compression regression suite. It generates a fixed corpus in memory (text,
+ * JSON, binary records, random and highly repetitive data), and compresses and
+ * uncompresses each corpus entry over the gzip, zlib and raw wrappers, levels
+ * 1, 3, 6 and 9, the default, filtered, huffman and rle strategies, and in
+ * one-shot and streaming modes. Each case is round-trip checked. For each case
+ * the compressed size and the compress and uncompress rates (MB/s) are
+ * recorded; with --update or --check-speed, each rate is the median of
+ * --repeat samples (default 5), otherwise of one.
+ *
+ * With --baseline file, the results are compared to a baseline written by an
+ * earlier --update file run. A case regresses if its compressed size grew by
+ * more than --size-tolerance percent (default 1). The program exits 1 if any
+ * case regresses or fails its round-trip check. Compressed sizes are the same
+ * on every machine, so that is all that is compared by default. Rates depend
+ * on the machine, the build and its load: with --check-speed, a case also
+ * regresses if a rate dropped by more than --speed-tolerance percent (default
+ * 50) from the baseline rate scaled to this machine, which only catches gross
+ * slowdowns unless the baseline was written on the same machine.
+ *
+ * The baseline is a JSON object whose "results" array holds one object per
+ * case:
+ *
+ *   {"name": "text/gzip/6/default/oneshot", "size": 61234,
+ *    "compress_mbps": 41.2, "uncompress_mbps": 380.5}
+ *
+ * From a CMake build, run the suite against contrib/bench/regress_baseline.json
+ * with the zlib_regress_check target.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <math.h>
+#include <memory.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zlib.h"
+
+void error_exit(const char* error, int code) {
+  fprintf(stderr, "%s (%d)\n", error, code);
+  exit(code);
+}
+
+static const size_t kCorpusSize = 256 * 1024;
+static const size_t kStreamChunk = 16 * 1024;
+
+struct Corpus {
+  const char* name;
+  std::string data;
+};
+
+// xorshift64*: a small, fixed PRNG so that the corpus is identical everywhere.
+struct Random {
+  explicit Random(uint64_t seed) : state(seed) {}
+  uint32_t next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (uint32_t)((state * 0x2545F4914F6CDD1DULL) >> 32);
+  }
+  uint32_t below(uint32_t n) { return next() % n; }
+  uint64_t state;
+};
+
+static const char* kWords[] = {
+    "the",      "of",      "and",     "to",         "in",       "a",
+    "is",       "that",    "for",     "it",         "as",       "was",
+    "with",     "be",      "by",      "on",         "not",      "he",
+    "this",     "are",     "or",      "his",        "from",     "at",
+    "which",    "but",     "have",    "an",         "had",      "they",
+    "stream",   "window",  "buffer",  "compressed", "data",     "block",
+    "huffman",  "literal", "length",  "distance",   "checksum", "header",
+    "deflate",  "inflate", "output",  "input",      "level",    "strategy",
+    "memory",   "pointer", "return",  "function",   "value",    "state",
+};
+static const uint32_t kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+// Skewed towards the first words, roughly like natural language.
+const char* random_word(Random* random) {
+  uint32_t a = random->below(kWordCount);
+  uint32_t b = random->below(kWordCount);
+  return kWords[std::min(a, b)];
+}
+
+std::string make_text(size_t size) {
+  Random random(1);
+  std::string text;
+  size_t line = 0;
+  while (text.size() < size) {
+    const char* word = random_word(&random);
+    text.append(word);
+    line += strlen(word) + 1;
+    if (random.below(12) == 0) {
+      text.append(random.below(3) ? ". " : ", ");
+    }
+    if (line > 64) {
+      text.push_back('\n');
+      line = 0;
+    } else {
+      text.push_back(' ');
+    }
+  }
+  text.resize(size);
+  return text;
+}
+
+std::string make_json(size_t size) {
+  Random random(2);
+  std::string json("[\n");
+  char record[256];
+  for (unsigned id = 0; json.size() < size; ++id) {
+    snprintf(record, sizeof(record),
+             "  {\"id\": %u, \"name\": \"%s %s\", \"score\": %u.%02u, "
+             "\"tags\": [\"%s\", \"%s\"], \"active\": %s},\n",
+             id, random_word(&random), random_word(&random),
+             random.below(1000), random.below(100), random_word(&random),
+             random_word(&random), random.below(2) ? "true" : "false");
+    json.append(record);
+  }
+  json.resize(size);
+  return json;
+}
+
+// Fixed size records of little-endian counters, timestamps with small deltas,
+// enum codes and noisy measurements, like a binary log or table.
+std::string make_binary(size_t size) {
+  Random random(3);
+  std::string binary;
+  uint32_t timestamp = 1600000000;
+  for (uint32_t i = 0; binary.size() < size; ++i) {
+    timestamp += random.below(16);
+    uint32_t fields[8] = {
+        0x5a4c4942u, i, timestamp, random.below(8),
+        random.below(1 << 12), random.next(), 0, 0xffffffffu,
+    };
+    for (uint32_t field : fields) {
+      for (int byte = 0; byte < 4; ++byte)
+        binary.push_back((char)(field >> (8 * byte)));
+    }
+  }
+  binary.resize(size);
+  return binary;
+}
+
+std::string make_random(size_t size) {
+  Random random(4);
+  std::string data(size, 0);
+  for (size_t i = 0; i < size; ++i)
+    data[i] = (char)random.next();
+  return data;
+}
+
+// A short pattern repeated, with a rare single byte change.
+std::string make_repetitive(size_t size) {
+  Random random(5);
+  std::string pattern = make_text(100);
+  std::string data;
+  while (data.size() < size) {
+    data.append(pattern);
+    if (random.below(64) == 0)
+      data[data.size() - 1 - random.below(100)] = (char)random.next();
+  }
+  data.resize(size);
+  return data;
+}
+
+std::vector<Corpus> make_corpus() {
+  std::vector<Corpus> corpus;
+  corpus.push_back({"text", make_text(kCorpusSize)});
+  corpus.push_back({"json", make_json(kCorpusSize)});
+  corpus.push_back({"binary", make_binary(kCorpusSize)});
+  corpus.push_back({"random", make_random(kCorpusSize)});
+  corpus.push_back({"repetitive", make_repetitive(kCorpusSize)});
+  return corpus;
+}
+
+struct Wrapper {
+  const char* name;
+  int window_bits;
+};
+
+static const Wrapper kWrappers[] = {
+    {"gzip", MAX_WBITS + 16},
+    {"zlib", MAX_WBITS},
+    {"raw", -MAX_WBITS},
+};
+
+struct Strategy {
+  const char* name;
+  int strategy;
+};
+
+static const Strategy kStrategies[] = {
+    {"default", Z_DEFAULT_STRATEGY},
+    {"filtered", Z_FILTERED},
+    {"huffman", Z_HUFFMAN_ONLY},
+    {"rle", Z_RLE},
+};
+
+static const int kLevels[] = {1, 3, 6, 9};
+
+struct Case {
+  const Corpus* corpus;
+  const Wrapper* wrapper;
+  int level;
+  const Strategy* strategy;
+  bool stream;
+};
+
+std::string case_name(const Case& c) {
+  char level[8];
+  snprintf(level, sizeof(level), "%d", c.level);
+  return std::string(c.corpus->name) + "/" + c.wrapper->name + "/" + level +
+         "/" + c.strategy->name + "/" + (c.stream ? "stream" : "oneshot");
+}
+
+// Compresses |input| to |output|, in one deflate() call or in kStreamChunk
+// pieces of input and output. Returns the compressed size.
+size_t compress_case(const Case& c, const std::string& input,
+                     std::string* output) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  int result = deflateInit2(&stream, c.level, Z_DEFLATED,
+                            c.wrapper->window_bits, 8, c.strategy->strategy);
+  if (result != Z_OK)
+    error_exit("deflateInit2 failed", result);
+  output->resize(deflateBound(&stream, (uLong)input.size()));
+
+  Bytef* out = (Bytef*)&(*output)[0];
+  z_const Bytef* in = (z_const Bytef*)input.data();
+  if (!c.stream) {
+    stream.next_in = in;
+    stream.avail_in = (uInt)input.size();
+    stream.next_out = out;
+    stream.avail_out = (uInt)output->size();
+    result = deflate(&stream, Z_FINISH);
+  } else {
+    size_t in_left = input.size();
+    do {
+      if (!stream.avail_in && in_left) {
+        stream.next_in = in + (input.size() - in_left);
+        stream.avail_in = (uInt)std::min(in_left, kStreamChunk);
+        in_left -= stream.avail_in;
+      }
+      size_t out_left = output->size() - stream.total_out;
+      stream.next_out = out + stream.total_out;
+      stream.avail_out = (uInt)std::min(out_left, kStreamChunk);
+      result = deflate(&stream, in_left ? Z_NO_FLUSH : Z_FINISH);
+    } while (result == Z_OK || result == Z_BUF_ERROR);
+  }
+  size_t size = stream.total_out;
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END)
+    error_exit("compress failed", result);
+  return size;
+}
+
+// Uncompresses |input| into |output|, which is sized to the expected length.
+// Returns false if the data does not uncompress to exactly that length.
+bool uncompress_case(const Case& c, const char* input, size_t input_size,
+                     std::string* output) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  int result = inflateInit2(&stream, c.wrapper->window_bits);
+  if (result != Z_OK)
+    error_exit("inflateInit2 failed", result);
+
+  Bytef* out = (Bytef*)&(*output)[0];
+  stream.next_in = (z_const Bytef*)input;
+  if (!c.stream) {
+    stream.avail_in = (uInt)input_size;
+    stream.next_out = out;
+    stream.avail_out = (uInt)output->size();
+    result = inflate(&stream, Z_FINISH);
+  } else {
+    do {
+      if (!stream.avail_in) {
+        stream.avail_in =
+            (uInt)std::min(input_size - stream.total_in, kStreamChunk);
+      }
+      size_t out_left = output->size() - stream.total_out;
+      stream.next_out = out + stream.total_out;
+      stream.avail_out = (uInt)std::min(out_left, kStreamChunk);
+      result = inflate(&stream, Z_NO_FLUSH);
+    } while (result == Z_OK);
+  }
+  bool ok = result == Z_STREAM_END && stream.total_out == output->size();
+  inflateEnd(&stream);
+  return ok;
+}
+
+struct Result {
+  size_t size = 0;
+  double compress_mbps = 0;
+  double uncompress_mbps = 0;
+};
+
+typedef std::chrono::steady_clock::time_point time_point;
+
+inline time_point time_now() {
+  return std::chrono::steady_clock::now();
+}
+
+double mbps(size_t bytes, time_point start, time_point end) {
+  std::chrono::duration<double> seconds = end - start;
+  return seconds.count() > 0 ? bytes / seconds.count() / 1e6 : 0;
+}
+
+// Each rate sample loops for at least this long, to smooth out timer and
+// scheduling noise on the small corpus entries.
+static const std::chrono::milliseconds kMinSampleTime(5);
+
+// Returns the median of |samples| rates of calling |function|, which processes
+// |bytes| of input per call. Unlike the best rate, the median is not set by
+// one lucky sample, so it moves less from run to run.
+template <typename Function>
+double median_rate(size_t bytes, int samples, Function function) {
+  std::vector<double> rates;
+  for (int i = 0; i < samples; ++i) {
+    size_t total = 0;
+    time_point start = time_now();
+    time_point end;
+    do {
+      function();
+      total += bytes;
+      end = time_now();
+    } while (end - start < kMinSampleTime);
+    rates.push_back(mbps(total, start, end));
+  }
+  std::sort(rates.begin(), rates.end());
+  size_t middle = rates.size() / 2;
+  return rates.size() % 2 ? rates[middle]
+                          : (rates[middle - 1] + rates[middle]) / 2;
+}
+
+bool run_case(const Case& c, int samples, Result* result) {
+  const std::string& input = c.corpus->data;
+  std::string compressed;
+  std::string output(input.size(), 0);
+  result->compress_mbps = median_rate(input.size(), samples, [&] {
+    result->size = compress_case(c, input, &compressed);
+  });
+  bool ok = true;
+  result->uncompress_mbps = median_rate(input.size(), samples, [&] {
+    ok &= uncompress_case(c, compressed.data(), result->size, &output);
+  });
+  return ok && output == input;
+}
+
+// The rate of a fixed loop that does not call zlib (FNV-1a over the corpus).
+// Baseline rates are scaled by the ratio of this rate to the baseline one, so
+// that a uniformly slower or faster machine does not read as a regression.
+volatile uint32_t calibration_sink;
+
+double calibration_rate(const std::vector<Corpus>& corpus, int samples) {
+  return median_rate(corpus.size() * kCorpusSize, samples, [&] {
+    uint32_t hash = 2166136261u;
+    for (const Corpus& data : corpus) {
+      for (char byte : data.data)
+        hash = (hash ^ (uint8_t)byte) * 16777619u;
+    }
+    calibration_sink = hash;
+  });
+}
+
+// Returns the metrics of |result| that regressed from |expected|, if any.
+// Rates are only compared if |min_rate| is above 0.
+std::string compare(const Result& result, const Result& expected,
+                    double min_rate, double max_size) {
+  std::string verdict;
+  if (result.size > max_size)
+    verdict += " size";
+  if (min_rate > 0 && result.compress_mbps < expected.compress_mbps * min_rate)
+    verdict += " compress";
+  if (min_rate > 0 &&
+      result.uncompress_mbps < expected.uncompress_mbps * min_rate)
+    verdict += " uncompress";
+  return verdict;
+}
+
+// A JSON value, as parsed by JsonParser.
+struct JsonValue {
+  enum Type { kNull, kBool, kNumber, kString, kArray, kObject };
+  Type type = kNull;
+  bool boolean = false;
+  double number = 0;
+  std::string string;
+  std::vector<JsonValue> array;
+  std::vector<std::pair<std::string, JsonValue>> object;
+
+  // Returns the member of an object named |key|, or nullptr.
+  const JsonValue* find(const char* key) const {
+    for (const auto& member : object) {
+      if (member.first == key)
+        return &member.second;
+    }
+    return nullptr;
+  }
+};
+
+// A strict RFC 8259 parser, enough to read a baseline back whatever its
+// layout: whitespace, member order and unknown members do not matter.
+class JsonParser {
+ public:
+  JsonParser(const char* data, size_t size)
+      : next_(data), end_(data + size), start_(data) {}
+
+  // Parses the text as one JSON value. On failure, returns false and sets
+  // |error| to the reason and its offset.
+  bool parse(JsonValue* value, std::string* error) {
+    skip_space();
+    if (parse_value(value, 0)) {
+      skip_space();
+      if (next_ == end_)
+        return true;
+      error_ = "unexpected data after the value";
+    }
+    *error = error_ + " at offset " + std::to_string(next_ - start_);
+    return false;
+  }
+
+ private:
+  static const int kMaxDepth = 64;
+
+  bool fail(const char* error) {
+    error_ = error;
+    return false;
+  }
+
+  void skip_space() {
+    while (next_ < end_ && (*next_ == ' ' || *next_ == '\t' ||
+                            *next_ == '\n' || *next_ == '\r'))
+      ++next_;
+  }
+
+  bool consume(const char* literal) {
+    size_t length = strlen(literal);
+    if ((size_t)(end_ - next_) < length || memcmp(next_, literal, length))
+      return false;
+    next_ += length;
+    return true;
+  }
+
+  bool parse_value(JsonValue* value, int depth) {
+    if (depth > kMaxDepth)
+      return fail("nested too deeply");
+    if (next_ == end_)
+      return fail("unexpected end of data");
+    switch (*next_) {
+      case '{':
+        return parse_object(value, depth);
+      case '[':
+        return parse_array(value, depth);
+      case '"':
+        value->type = JsonValue::kString;
+        return parse_string(&value->string);
+      case 't':
+      case 'f':
+        value->type = JsonValue::kBool;
+        value->boolean = *next_ == 't';
+        return consume(value->boolean ? "true" : "false") ||
+               fail("invalid literal");
+      case 'n':
+        value->type = JsonValue::kNull;
+        return consume("null") || fail("invalid literal");
+      default:
+        return parse_number(value);
+    }
+  }
+
+  bool parse_object(JsonValue* value, int depth) {
+    value->type = JsonValue::kObject;
+    ++next_;
+    skip_space();
+    if (consume("}"))
+      return true;
+    for (;;) {
+      std::pair<std::string, JsonValue> member;
+      if (next_ == end_ || *next_ != '"')
+        return fail("expected a member name");
+      if (!parse_string(&member.first))
+        return false;
+      skip_space();
+      if (!consume(":"))
+        return fail("expected ':'");
+      skip_space();
+      if (!parse_value(&member.second, depth + 1))
+        return false;
+      value->object.push_back(std::move(member));
+      skip_space();
+      if (consume("}"))
+        return true;
+      if (!consume(","))
+        return fail("expected ',' or '}'");
+      skip_space();
+    }
+  }
+
+  bool parse_array(JsonValue* value, int depth) {
+    value->type = JsonValue::kArray;
+    ++next_;
+    skip_space();
+    if (consume("]"))
+      return true;
+    for (;;) {
+      value->array.emplace_back();
+      if (!parse_value(&value->array.back(), depth + 1))
+        return false;
+      skip_space();
+      if (consume("]"))
+        return true;
+      if (!consume(","))
+        return fail("expected ',' or ']'");
+      skip_space();
+    }
+  }
+
+  bool parse_hex4(uint32_t* code) {
+    if (end_ - next_ < 4)
+      return fail("truncated \\u escape");
+    *code = 0;
+    for (int i = 0; i < 4; ++i) {
+      char digit = *next_++;
+      *code <<= 4;
+      if (digit >= '0' && digit <= '9')
+        *code |= digit - '0';
+      else if (digit >= 'a' && digit <= 'f')
+        *code |= digit - 'a' + 10;
+      else if (digit >= 'A' && digit <= 'F')
+        *code |= digit - 'A' + 10;
+      else
+        return fail("invalid \\u escape");
+    }
+    return true;
+  }
+
+  static void append_utf8(uint32_t code, std::string* text) {
+    if (code < 0x80) {
+      text->push_back((char)code);
+    } else if (code < 0x800) {
+      text->push_back((char)(0xc0 | code >> 6));
+      text->push_back((char)(0x80 | (code & 0x3f)));
+    } else if (code < 0x10000) {
+      text->push_back((char)(0xe0 | code >> 12));
+      text->push_back((char)(0x80 | ((code >> 6) & 0x3f)));
+      text->push_back((char)(0x80 | (code & 0x3f)));
+    } else {
+      text->push_back((char)(0xf0 | code >> 18));
+      text->push_back((char)(0x80 | ((code >> 12) & 0x3f)));
+      text->push_back((char)(0x80 | ((code >> 6) & 0x3f)));
+      text->push_back((char)(0x80 | (code & 0x3f)));
+    }
+  }
+
+  bool parse_string(std::string* text) {
+    ++next_;
+    for (;;) {
+      if (next_ == end_)
+        return fail("unterminated string");
+      char c = *next_++;
+      if (c == '"')
+        return true;
+      if ((unsigned char)c < 0x20)
+        return fail("control character in string");
+      if (c != '\\') {
+        text->push_back(c);
+        continue;
+      }
+      if (next_ == end_)
+        return fail("unterminated string");
+      switch (c = *next_++) {
+        case '"':
+        case '\\':
+        case '/':
+          text->push_back(c);
+          break;
+        case 'b':
+          text->push_back('\b');
+          break;
+        case 'f':
+          text->push_back('\f');
+          break;
+        case 'n':
+          text->push_back('\n');
+          break;
+        case 'r':
+          text->push_back('\r');
+          break;
+        case 't':
+          text->push_back('\t');
+          break;
+        case 'u': {
+          uint32_t code;
+          if (!parse_hex4(&code))
+            return false;
+          if (code >= 0xdc00 && code < 0xe000)
+            return fail("unpaired surrogate");
+          if (code >= 0xd800 && code < 0xdc00) {
+            uint32_t low;
+            if (!consume("\\u") || !parse_hex4(&low) || low < 0xdc00 ||
+                low >= 0xe000)
+              return fail("unpaired surrogate");
+            code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+          }
+          append_utf8(code, text);
+          break;
+        }
+        default:
+          return fail("invalid escape");
+      }
+    }
+  }
+
+  // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+  bool parse_number(JsonValue* value) {
+    const char* start = next_;
+    auto digits = [this] {
+      const char* first = next_;
+      while (next_ < end_ && *next_ >= '0' && *next_ <= '9')
+        ++next_;
+      return next_ > first;
+    };
+    consume("-");
+    if (!consume("0") && !(next_ < end_ && *next_ >= '1' && digits()))
+      return fail("invalid value");
+    if (consume(".") && !digits())
+      return fail("invalid number");
+    if (consume("e") || consume("E")) {
+      if (!consume("+"))
+        consume("-");
+      if (!digits())
+        return fail("invalid number");
+    }
+    value->type = JsonValue::kNumber;
+    value->number = strtod(std::string(start, next_).c_str(), nullptr);
+    return true;
+  }
+
+  const char* next_;
+  const char* end_;
+  const char* start_;
+  std::string error_;
+};
+
+// Returns the number member |key| of |object|, or -1 if it has none.
+double json_number(const JsonValue& object, const char* key) {
+  const JsonValue* value = object.find(key);
+  return value && value->type == JsonValue::kNumber ? value->number : -1;
+}
+
+// Reads a baseline written by write_baseline(). Members other than the
+// calibration rate and the results, such as the description, are ignored.
+bool read_baseline(const char* path, double* calibration,
+                   std::map<std::string, Result>* baseline) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  std::string text;
+  char buffer[64 * 1024];
+  size_t length;
+  while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    text.append(buffer, length);
+  bool read_error = ferror(file);
+  fclose(file);
+  if (read_error) {
+    perror(path);
+    return false;
+  }
+
+  JsonValue root;
+  std::string error;
+  if (!JsonParser(text.data(), text.size()).parse(&root, &error)) {
+    fprintf(stderr, "%s: %s\n", path, error.c_str());
+    return false;
+  }
+  const JsonValue* results = root.find("results");
+  if (root.type != JsonValue::kObject || !results ||
+      results->type != JsonValue::kArray) {
+    fprintf(stderr, "%s: expected an object with a \"results\" array\n",
+            path);
+    return false;
+  }
+  *calibration = std::max(json_number(root, "calibration_mbps"), 0.0);
+  for (const JsonValue& entry : results->array) {
+    const JsonValue* name = entry.find("name");
+    Result result;
+    double size = json_number(entry, "size");
+    result.compress_mbps = json_number(entry, "compress_mbps");
+    result.uncompress_mbps = json_number(entry, "uncompress_mbps");
+    if (!name || name->type != JsonValue::kString || size < 0 ||
+        size != floor(size) || result.compress_mbps < 0 ||
+        result.uncompress_mbps < 0) {
+      fprintf(stderr, "%s: bad result %zu\n", path,
+              (size_t)(&entry - &results->array[0]));
+      return false;
+    }
+    result.size = (size_t)size;
+    (*baseline)[name->string] = result;
+  }
+  return true;
+}
+
+bool write_baseline(const char* path, double calibration,
+                    const std::vector<std::pair<std::string, Result>>& results) {
+  FILE* file = fopen(path, "w");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  fprintf(file, "{\n  \"description\": \"zlib_regress baseline, zlib %s\",\n",
+          ZLIB_VERSION);
+  fprintf(file, "  \"corpus_size\": %zu,\n", kCorpusSize);
+  fprintf(file, "  \"calibration_mbps\": %.1f,\n", calibration);
+  fprintf(file, "  \"results\": [\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& result = results[i].second;
+    fprintf(file,
+            "    {\"name\": \"%s\", \"size\": %zu, \"compress_mbps\": %.1f, "
+            "\"uncompress_mbps\": %.1f}%s\n",
+            results[i].first.c_str(), result.size, result.compress_mbps,
+            result.uncompress_mbps, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+  return fclose(file) == 0;
+}
+
+// Checks deflateEstimate() against the real raw deflate size of each corpus
+// entry at each level, and reports its rate on the entry and on a 16 MB input.
+// Returns the number of estimates off by more than |tolerance| percent of the
+// actual compressed size.
+int run_estimates(const std::vector<Corpus>& corpus, double tolerance,
+                  int repeat) {
+  static const Wrapper kRaw = {"raw", -MAX_WBITS};
+  static const Strategy kDefault = {"default", Z_DEFAULT_STRATEGY};
+  int misses = 0;
+  printf("%-24s %10s %10s %8s %10s\n", "estimate", "estimated", "actual",
+         "error %", "GB/s");
+  for (const Corpus& data : corpus) {
+    const Bytef* input = (const Bytef*)data.data.data();
+    z_deflate_estimate estimate;
+    double rate = median_rate(data.data.size(), repeat, [&] {
+      deflateEstimate(input, data.data.size(), &estimate);
+    });
+    printf("%-24s entropy %.3f bits/byte, %zu bytes sampled\n", data.name,
+           estimate.entropy / 1000.0, (size_t)estimate.sampled);
+    for (int level : kLevels) {
+      Case c = {&data, &kRaw, level, &kDefault, false};
+      std::string compressed;
+      size_t actual = compress_case(c, data.data, &compressed);
+      size_t estimated = estimate.size[level];
+      double error = 100.0 * ((double)estimated - (double)actual) / actual;
+      bool miss = fabs(error) > tolerance;
+      misses += miss;
+      printf("%-24s %10zu %10zu %+8.1f %10.1f%s\n",
+             (std::string(data.name) + "/" + std::to_string(level)).c_str(),
+             estimated, actual, error, rate / 1000, miss ? " MISSED" : "");
+    }
+  }
+
+  std::string large;
+  while (large.size() < 16 * 1024 * 1024) {
+    for (const Corpus& data : corpus)
+      large.append(data.data);
+  }
+  z_deflate_estimate estimate;
+  double rate = median_rate(large.size(), repeat, [&] {
+    deflateEstimate((const Bytef*)large.data(), large.size(), &estimate);
+  });
+  printf("%-24s %10zu %10s %8s %10.1f\n", "16 MB mixed", estimate.size[6],
+         "", "", rate / 1000);
+  printf("%d of %zu estimates off by more than %.0f%%\n", misses,
+         corpus.size() * sizeof(kLevels) / sizeof(kLevels[0]), tolerance);
+  return misses;
+}
+
+static int argn = 1;
+
+char* get_option(int argc, char* argv[], const char* option) {
+  if (argn < argc)
+    return !strcmp(argv[argn], option) ? argv[argn++] : nullptr;
+  return nullptr;
+}
+
+char* get_value(int argc, char* argv[]) {
+  return argn < argc ? argv[argn++] : nullptr;
+}
+
+bool get_percent(int argc, char* argv[], double& value) {
+  const char* text = get_value(argc, argv);
+  if (!text)
+    return false;
+  char* end;
+  value = strtod(text, &end);
+  return !*end && value >= 0 && value <= 100;
+}
+
+void usage_exit(const char* program) {
+  static auto* options =
+      "[--baseline file] [--update file] [--size-tolerance percent]"
+      " [--check-speed] [--speed-tolerance percent] [--repeat N]"
+      " [--filter substring]"
+      " [--estimate percent]";
+  printf("usage: %s %s\n", program, options);
+  printf("zlib version: %s\n", ZLIB_VERSION);
+  exit(1);
+}
+
+int main(int argc, char* argv[]) {
+  const char* baseline_path = nullptr;
+  const char* update_path = nullptr;
+  const char* filter = nullptr;
+  double size_tolerance = 1;
+  bool check_speed = false;
+  double speed_tolerance = 50;
+  int repeat = 5;
+  double estimate_tolerance = -1;
+
+  while (argn < argc) {
+    if (get_option(argc, argv, "--baseline")) {
+      if (!(baseline_path = get_value(argc, argv)))
+        usage_exit(argv[0]);
+    } else if (get_option(argc, argv, "--update")) {
+      if (!(update_path = get_value(argc, argv)))
+        usage_exit(argv[0]);
+    } else if (get_option(argc, argv, "--filter")) {
+      if (!(filter = get_value(argc, argv)))
+        usage_exit(argv[0]);
+    } else if (get_option(argc, argv, "--size-tolerance")) {
+      if (!get_percent(argc, argv, size_tolerance))
+        usage_exit(argv[0]);
+    } else if (get_option(argc, argv, "--check-speed")) {
+      check_speed = true;
+    } else if (get_option(argc, argv, "--speed-tolerance")) {
+      if (!get_percent(argc, argv, speed_tolerance))
+        usage_exit(argv[0]);
+      check_speed = true;
+    } else if (get_option(argc, argv, "--estimate")) {
+      if (!get_percent(argc, argv, estimate_tolerance))
+        usage_exit(argv[0]);
+    } else if (get_option(argc, argv, "--repeat")) {
+      const char* count = get_value(argc, argv);
+      if (!count || (repeat = atoi(count)) <= 0)
+        usage_exit(argv[0]);
+    } else {
+      usage_exit(argv[0]);
+    }
+  }
+
+  if (estimate_tolerance >= 0)
+    return run_estimates(make_corpus(), estimate_tolerance, repeat) ? 1 : 0;
+
+  std::map<std::string, Result> baseline;
+  double baseline_calibration = 0;
+  if (baseline_path &&
+      !read_baseline(baseline_path, &baseline_calibration, &baseline))
+    return 1;
+
+  // Rates only need several samples if they are compared or kept.
+  int samples = check_speed || update_path ? repeat : 1;
+  std::vector<Corpus> corpus = make_corpus();
+  double calibration = calibration_rate(corpus, samples);
+  double speed_scale = 1;
+  if (baseline_calibration > 0)
+    speed_scale = calibration / baseline_calibration;
+  printf("calibration %.1f MB/s", calibration);
+  if (baseline_path && check_speed)
+    printf(", baseline rates scaled by %.2f", speed_scale);
+  printf("\n\n");
+  std::vector<std::pair<std::string, Result>> results;
+  int failures = 0;
+  int regressions = 0;
+
+  printf("%-40s %10s %10s %10s\n", "case", "size", "comp MB/s",
+         "uncomp MB/s");
+  for (const Corpus& data : corpus) {
+    for (const Wrapper& wrapper : kWrappers) {
+      for (int level : kLevels) {
+        for (const Strategy& strategy : kStrategies) {
+          for (bool stream : {false, true}) {
+            Case c = {&data, &wrapper, level, &strategy, stream};
+            std::string name = case_name(c);
+            if (filter && name.find(filter) == std::string::npos)
+              continue;
+
+            Result result;
+            if (!run_case(c, samples, &result)) {
+              printf("%-40s FAILED round-trip check\n", name.c_str());
+              ++failures;
+              continue;
+            }
+
+            std::string verdict;
+            auto base = baseline.find(name);
+            if (base != baseline.end()) {
+              const Result& expected = base->second;
+              double min_rate =
+                  check_speed ? speed_scale * (1 - speed_tolerance / 100) : 0;
+              double max_size = expected.size * (1 + size_tolerance / 100);
+              verdict = compare(result, expected, min_rate, max_size);
+              if (!verdict.empty()) {
+                ++regressions;
+                char was[96];
+                snprintf(was, sizeof(was), " (was %zu %.1f %.1f)",
+                         expected.size, expected.compress_mbps,
+                         expected.uncompress_mbps);
+                verdict = " REGRESSED:" + verdict + was;
+              }
+            } else if (baseline_path) {
+              verdict = " (not in baseline)";
+            }
+            results.push_back(std::make_pair(name, result));
+
+            printf("%-40s %10zu %10.1f %10.1f%s\n", name.c_str(), result.size,
+                   result.compress_mbps, result.uncompress_mbps,
+                   verdict.c_str());
+          }
+        }
+      }
+    }
+  }
+
+  if (update_path && !write_baseline(update_path, calibration, results))
+    return 1;
+
+  printf("%zu cases, %d failed, %d regressed\n", results.size() + failures,
+         failures, regressions);
+  return failures || regressions ? 1 : 0;
+}
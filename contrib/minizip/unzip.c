@@ -71,6 +71,17 @@
 #include "zlib.h"
 #include "unzip.h"
 
+/* The USDT probes are only available when built in the zlib tree, not
+   against an installed zlib. */
+#if defined(__has_include)
+#  if __has_include("zprobes.h")
+#    include "zprobes.h"
+#  endif
+#endif
+#ifndef Z_PROBE5
+#  define Z_PROBE5(name, a, b, c, d, e) do {} while (0)
+#endif
+
 #ifdef STDC
 #  include <stddef.h>
 #endif
@@ -1580,6 +1591,9 @@ extern int ZEXPORT unzOpenCurrentFile3(unzFile file, int* method,
     }
 #    endif
 
+    Z_PROBE5(unz_open_file, file, s->cur_file_info.compression_method,
+             s->cur_file_info.compressed_size,
+             s->cur_file_info.uncompressed_size, raw);
 
     return UNZ_OK;
 }
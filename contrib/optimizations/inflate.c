@@ -85,6 +85,9 @@
 #include "inflate.h"
 #include "contrib/optimizations/inffast_chunk.h"
 #include "contrib/optimizations/chunkcopy.h"
+#include "cpu_features.h"
+#include "zprobes.h"
+#include "gzheader.h"
 
 #ifdef MAKEFIXED
 #  ifndef BUILDFIXED
@@ -124,6 +127,9 @@ int ZEXPORT inflateResetKeep(z_streamp strm) {
     state->lencode = state->distcode = state->next = state->codes;
     state->sane = 1;
     state->back = -1;
+#ifdef ZLIB_STATS
+    zmemzero((Bytef *)&state->stats, sizeof(state->stats));
+#endif
     Tracev((stderr, "inflate: reset\n"));
     return Z_OK;
 }
@@ -181,6 +187,9 @@ int ZEXPORT inflateInit2_(z_streamp strm, int windowBits,
     int ret;
     struct inflate_state FAR *state;
 
+    /* Reads the kernel tier, which selects inflate_fast_chunk_() below. */
+    cpu_check_features();
+
     if (version == Z_NULL || version[0] != ZLIB_VERSION[0] ||
         stream_size != (int)(sizeof(z_stream)))
         return Z_VERSION_ERROR;
@@ -206,6 +215,9 @@ int ZEXPORT inflateInit2_(z_streamp strm, int windowBits,
     Tracev((stderr, "inflate: allocated\n"));
     strm->state = (struct internal_state FAR *)state;
     state->strm = strm;
+#ifdef ZLIB_STATS
+    state->back_strm = Z_NULL;
+#endif
     state->window = Z_NULL;
     state->mode = HEAD;     /* to pass state test in inflateReset2() */
     state->check = 1L;      /* 1L is the result of adler32() zero length data */
@@ -372,6 +384,7 @@ local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy) {
     unsigned dist;
 
     state = (struct inflate_state FAR *)strm->state;
+    INFLATE_STAT(state, window_updates, 1);
 
     /* if it hasn't been done already, allocate space for the window */
     if (state->window == Z_NULL) {
@@ -423,6 +436,64 @@ local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy) {
     return 0;
 }
 
+#ifdef GUNZIP
+/*
+   Reads a gzip header that is entirely in next[0..have) in one pass, setting
+   state->flags and filling in state->head as the HEAD ... HCRC states would.
+   Returns the length of the header, or 0 if it is incomplete or invalid, in
+   which case those states decode it a byte at a time and report any error.
+ */
+local unsigned gzheader_fast(struct inflate_state FAR *state,
+                             z_const unsigned char FAR *next, unsigned have) {
+    gzhdr_info info;
+    gz_headerp head;
+    unsigned len;
+
+    if (gzhdr_parse(next, have, &info) != GZHDR_OK)
+        return 0;
+    if ((state->wrap & 4) && !gzhdr_check_hcrc(next, &info))
+        return 0;
+    state->flags = (int)(Z_DEFLATED | (info.flags << 8));
+    head = state->head;
+    if (head != Z_NULL) {
+        head->text = (int)(info.flags & GZHDR_FTEXT);
+        head->time = info.time;
+        head->xflags = info.xflags;
+        head->os = info.os;
+        if (info.flags & GZHDR_FEXTRA) {
+            head->extra_len = info.extra_len;
+            if (head->extra != Z_NULL)
+                zmemcpy(head->extra, next + info.extra,
+                        info.extra_len < head->extra_max ?
+                        info.extra_len : head->extra_max);
+        }
+        else
+            head->extra = Z_NULL;
+        if (info.flags & GZHDR_FNAME) {
+            if (head->name != Z_NULL) {
+                len = (unsigned)strlen((const char *)next + info.name) + 1;
+                zmemcpy(head->name, next + info.name,
+                        len < head->name_max ? len : head->name_max);
+            }
+        }
+        else
+            head->name = Z_NULL;
+        if (info.flags & GZHDR_FCOMMENT) {
+            if (head->comment != Z_NULL) {
+                len = (unsigned)strlen((const char *)next + info.comment) + 1;
+                zmemcpy(head->comment, next + info.comment,
+                        len < head->comm_max ? len : head->comm_max);
+            }
+        }
+        else
+            head->comment = Z_NULL;
+        head->hcrc = (int)((info.flags >> 1) & 1);
+        head->done = 1;
+    }
+    return (unsigned)info.length;
+}
+#endif
+
 /* Macros for inflate(): */
 
 /* check function to use adler32() for zlib or crc32() for gzip */
@@ -636,6 +707,19 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                 state->mode = TYPEDO;
                 break;
             }
+#ifdef GUNZIP
+            if ((state->wrap & 2) && bits == 0 &&
+                have >= GZHDR_FIXED_SIZE &&
+                (copy = gzheader_fast(state, next, have)) != 0) {
+                if (state->wbits == 0)
+                    state->wbits = 15;
+                next += copy;
+                have -= copy;
+                strm->adler = state->check = crc32(0L, Z_NULL, 0);
+                state->mode = TYPE;
+                break;
+            }
+#endif
             NEEDBITS(16);
 #ifdef GUNZIP
             if ((state->wrap & 2) && hold == 0x8b1f) {  /* gzip header */
@@ -823,6 +907,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             NEEDBITS(32);
             strm->adler = state->check = ZSWAP32(hold);
             INITBITS();
+            INFLATE_STAT(state, dictionary_requests, 1);
             state->mode = DICT;
                 /* fallthrough */
         case DICT:
@@ -845,16 +930,19 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             NEEDBITS(3);
             state->last = BITS(1);
             DROPBITS(1);
+            Z_PROBE3(inflate_block, strm, BITS(2), state->last);
             switch (BITS(2)) {
             case 0:                             /* stored block */
                 Tracev((stderr, "inflate:     stored block%s\n",
                         state->last ? " (last)" : ""));
+                INFLATE_STAT(state, stored_blocks, 1);
                 state->mode = STORED;
                 break;
             case 1:                             /* fixed block */
                 fixedtables(state);
                 Tracev((stderr, "inflate:     fixed codes block%s\n",
                         state->last ? " (last)" : ""));
+                INFLATE_STAT(state, fixed_blocks, 1);
                 state->mode = LEN_;             /* decode codes */
                 if (flush == Z_TREES) {
                     DROPBITS(2);
@@ -864,6 +952,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             case 2:                             /* dynamic block */
                 Tracev((stderr, "inflate:     dynamic codes block%s\n",
                         state->last ? " (last)" : ""));
+                INFLATE_STAT(state, dynamic_blocks, 1);
                 state->mode = TABLE;
                 break;
             case 3:
@@ -901,6 +990,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                 next += copy;
                 left -= copy;
                 put += copy;
+                INFLATE_STAT(state, slow_bytes, copy);
                 state->length -= copy;
                 break;
             }
@@ -1029,6 +1119,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                 break;
             }
             Tracev((stderr, "inflate:       codes ok\n"));
+            INFLATE_STAT(state, table_builds, 1);
             state->mode = LEN_;
             if (flush == Z_TREES) goto inf_leave;
                 /* fallthrough */
@@ -1039,7 +1130,10 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             if (have >= INFLATE_FAST_MIN_INPUT &&
                 left >= INFLATE_FAST_MIN_OUTPUT) {
                 RESTORE();
-                inflate_fast_chunk_(strm, out);
+                if (cpu_max_tier >= CPU_TIER_SSSE3)
+                    inflate_fast_chunk_(strm, out);
+                else
+                    inflate_fast(strm, out);
                 LOAD();
                 if (state->mode == TYPE)
                     state->back = -1;
@@ -1160,6 +1254,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                     if (copy > left) copy = left;
                     left -= copy;
                     state->length -= copy;
+                    INFLATE_STAT(state, slow_bytes, copy);
                     do {
                         *put++ = 0;
                     } while (--copy);
@@ -1184,12 +1279,14 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             }
             left -= copy;
             state->length -= copy;
+            INFLATE_STAT(state, slow_bytes, copy);
             if (state->length == 0) state->mode = LEN;
             break;
         case LIT:
             if (left == 0) goto inf_leave;
             *put++ = (unsigned char)(state->length);
             left--;
+            INFLATE_STAT(state, slow_bytes, 1);
             state->mode = LEN;
             break;
         case CHECK:
@@ -1310,6 +1407,33 @@ int ZEXPORT inflateEnd(z_streamp strm) {
     return Z_OK;
 }
 
+int ZEXPORT inflateGetStats(z_streamp strm, z_inflate_stats *stats) {
+#ifdef ZLIB_STATS
+    struct inflate_state FAR *state;
+    if (stats == Z_NULL) return Z_STREAM_ERROR;
+    if (inflateStateCheck(strm) &&
+        (strm == Z_NULL || strm->state == Z_NULL ||
+         ((struct inflate_state FAR *)strm->state)->back_strm != strm))
+        return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    *stats = state->stats;
+    if (state->back_strm == strm) {
+        /* inflateBack() does not update the stream totals */
+        stats->total_in = 0;
+        stats->total_out = stats->fast_bytes + stats->slow_bytes;
+    }
+    else {
+        stats->total_in = strm->total_in;
+        stats->total_out = strm->total_out;
+    }
+    return Z_OK;
+#else
+    (void)strm;
+    (void)stats;
+    return Z_STREAM_ERROR;
+#endif
+}
+
 int ZEXPORT inflateGetDictionary(z_streamp strm, Bytef *dictionary,
                                  uInt *dictLength) {
     struct inflate_state FAR *state;
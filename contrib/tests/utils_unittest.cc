@@ -4,11 +4,16 @@
 
 #include "infcover.h"
 
+#include <stdio.h>
+
 #include <cstddef>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "compression_utils_portable.h"
 #include "gtest.h"
+#include "gzheader.h"
 
 #if !defined(CMAKE_STANDALONE_UNITTESTS)
 #include "base/files/file_path.h"
@@ -20,6 +25,12 @@
 
 #include "zlib.h"
 
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 void TestPayloads(size_t input_size, zlib_internal::WrapperType type,
                   const int compression_level = Z_DEFAULT_COMPRESSION) {
   std::vector<unsigned char> input;
@@ -123,6 +134,57 @@ TEST(ZlibTest, DeflateStored) {
   EXPECT_EQ(input, decompressed);
 }
 
+TEST(ZlibTest, DeflateStoredAdler32) {
+  // Level 0 computes the Adler-32 while copying the input; check it against
+  // adler32() for lengths and alignments around the SIMD block size.
+  std::vector<unsigned char> input(70000 + 64);
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = static_cast<unsigned char>(i * 2654435761u >> 24);
+  std::vector<unsigned char> compressed(compressBound(input.size()));
+  for (size_t length : {0, 1, 31, 63, 64, 65, 100, 5552, 5553, 70000}) {
+    for (size_t offset : {0, 1, 7, 16}) {
+      const unsigned char* data = input.data() + offset;
+      uLongf compressed_size = compressed.size();
+      ASSERT_EQ(compress2(compressed.data(), &compressed_size, data, length,
+                          Z_NO_COMPRESSION),
+                Z_OK);
+      const unsigned char* trailer = compressed.data() + compressed_size - 4;
+      uLong check = (uLong)trailer[0] << 24 | trailer[1] << 16 |
+                    trailer[2] << 8 | trailer[3];
+      EXPECT_EQ(check, adler32(1, data, length)) << length << " " << offset;
+
+      std::vector<unsigned char> output(length + 1);
+      uLongf output_size = output.size();
+      ASSERT_EQ(uncompress(output.data(), &output_size, compressed.data(),
+                           compressed_size),
+                Z_OK);
+      ASSERT_EQ(output_size, length);
+      EXPECT_EQ(0, memcmp(output.data(), data, length));
+    }
+  }
+}
+
+TEST(ZlibTest, ChecksumKernelLengths) {
+  // crc32_z() and adler32_z() call the kernel chosen for the CPU, which leaves
+  // a tail to the next kernel down; check them byte by byte against the
+  // one-byte-at-a-time results around each kernel's minimum length.
+  std::vector<unsigned char> input(1100);
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = static_cast<unsigned char>(i * 2654435761u >> 24);
+  for (size_t offset : {0, 3}) {
+    const unsigned char* data = input.data() + offset;
+    uLong crc = crc32_z(0, nullptr, 0);
+    uLong adler = adler32_z(0, nullptr, 0);
+    for (size_t length = 0; length <= 1024; ++length) {
+      EXPECT_EQ(crc32_z(0, data, length), crc) << length << " " << offset;
+      EXPECT_EQ(crc32(0, data, length), crc) << length << " " << offset;
+      EXPECT_EQ(adler32_z(1, data, length), adler) << length << " " << offset;
+      crc = crc32_z(crc, data + length, 1);
+      adler = adler32_z(adler, data + length, 1);
+    }
+  }
+}
+
 TEST(ZlibTest, StreamingInflate) {
   uint8_t comp_buf[4096], decomp_buf[4096];
   z_stream comp_strm, decomp_strm;
@@ -1165,6 +1227,997 @@ TEST(ZlibTest, DeflateBound) {
   deflateEnd(&stream);
 }
 
+TEST(ZlibTest, AllocStats) {
+  // Check that zallocTracked() accounts for the memory used by a stream.
+  z_alloc_stats stats = {};
+  z_stream stream = {};
+  stream.zalloc = zallocTracked;
+  stream.zfree = zfreeTracked;
+  stream.opaque = &stats;
+  int ret = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15, 8,
+                         Z_DEFAULT_STRATEGY);
+  ASSERT_EQ(ret, Z_OK);
+
+  z_alloc_stats current;
+  ASSERT_EQ(zallocGetStats(&stream, &current), Z_OK);
+  // The window (2 * 32K), prev (2 * 32K) and head (2 * 32K) at least.
+  EXPECT_GE(current.current, 3u * 64 * 1024);
+  EXPECT_EQ(current.peak, current.current);
+  EXPECT_EQ(current.total, current.current);
+  EXPECT_GT(current.allocs, 0u);
+
+  deflateEnd(&stream);
+  ASSERT_EQ(zallocGetStats(&stream, &current), Z_OK);
+  EXPECT_EQ(current.current, 0u);
+  EXPECT_GE(current.peak, 3u * 64 * 1024);
+
+  // A smaller window and memLevel use less memory.
+  z_alloc_stats small_stats = {};
+  stream = {};
+  stream.zalloc = zallocTracked;
+  stream.zfree = zfreeTracked;
+  stream.opaque = &small_stats;
+  ret = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 10, 1,
+                     Z_DEFAULT_STRATEGY);
+  ASSERT_EQ(ret, Z_OK);
+  deflateEnd(&stream);
+  EXPECT_LT(small_stats.peak, stats.peak);
+
+  // Streams that do not use zallocTracked() have no stats.
+  stream = {};
+  ret = inflateInit(&stream);
+  ASSERT_EQ(ret, Z_OK);
+  EXPECT_EQ(zallocGetStats(&stream, &current), Z_STREAM_ERROR);
+  inflateEnd(&stream);
+}
+
+TEST(ZlibTest, DeflateGetStats) {
+  // Check the deflateGetStats() counters, when compiled in.
+  std::vector<uint8_t> input(256 * 1024);
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = static_cast<uint8_t>((i % 251) ^ (i >> 12));
+
+  z_stream stream = {};
+  int ret = deflateInit(&stream, Z_DEFAULT_COMPRESSION);
+  ASSERT_EQ(ret, Z_OK);
+  z_deflate_stats stats;
+  ret = deflateGetStats(&stream, &stats);
+  if (ret == Z_STREAM_ERROR) {
+    deflateEnd(&stream);
+    GTEST_SKIP() << "zlib built without ZLIB_STATS";
+  }
+  ASSERT_EQ(ret, Z_OK);
+  EXPECT_EQ(stats.literals + stats.matches + stats.window_slides +
+                stats.bypassed,
+            0u);
+
+  std::vector<uint8_t> compressed(deflateBound(&stream, input.size()));
+  stream.next_in = input.data();
+  stream.avail_in = input.size();
+  stream.next_out = compressed.data();
+  stream.avail_out = compressed.size();
+  ret = deflate(&stream, Z_FINISH);
+  ASSERT_EQ(ret, Z_STREAM_END);
+
+  ASSERT_EQ(deflateGetStats(&stream, &stats), Z_OK);
+  EXPECT_EQ(stats.total_in, input.size());
+  EXPECT_EQ(stats.total_out, stream.total_out);
+  EXPECT_EQ(stats.literals + stats.match_bytes, input.size());
+  EXPECT_GT(stats.matches, 0u);
+  EXPECT_GE(stats.chain_steps, stats.matches);
+  EXPECT_GT(stats.fixed_blocks + stats.dynamic_blocks, 0u);
+  EXPECT_GT(stats.window_slides, 0u);
+
+  // deflateReset() starts counting again.
+  ASSERT_EQ(deflateReset(&stream), Z_OK);
+  ASSERT_EQ(deflateGetStats(&stream, &stats), Z_OK);
+  EXPECT_EQ(stats.literals + stats.matches + stats.total_in, 0u);
+  deflateEnd(&stream);
+
+  EXPECT_EQ(deflateGetStats(&stream, &stats), Z_STREAM_ERROR);
+}
+
+TEST(ZlibTest, InflateGetStats) {
+  // Check the inflateGetStats() counters, when compiled in.
+  std::vector<uint8_t> input(256 * 1024);
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = static_cast<uint8_t>((i % 251) ^ (i >> 12));
+  std::vector<uint8_t> compressed(compressBound(input.size()));
+  uLongf compressed_size = compressed.size();
+  ASSERT_EQ(compress(compressed.data(), &compressed_size, input.data(),
+                     input.size()),
+            Z_OK);
+
+  z_stream stream = {};
+  int ret = inflateInit(&stream);
+  ASSERT_EQ(ret, Z_OK);
+  z_inflate_stats stats;
+  ret = inflateGetStats(&stream, &stats);
+  if (ret == Z_STREAM_ERROR) {
+    inflateEnd(&stream);
+    GTEST_SKIP() << "zlib built without ZLIB_STATS";
+  }
+  ASSERT_EQ(ret, Z_OK);
+
+  // Large buffers: the output is mostly decoded by the fast loop.
+  std::vector<uint8_t> output(input.size());
+  stream.next_in = compressed.data();
+  stream.avail_in = compressed_size;
+  stream.next_out = output.data();
+  stream.avail_out = output.size();
+  ASSERT_EQ(inflate(&stream, Z_FINISH), Z_STREAM_END);
+  EXPECT_EQ(output, input);
+
+  ASSERT_EQ(inflateGetStats(&stream, &stats), Z_OK);
+  EXPECT_EQ(stats.total_in, compressed_size);
+  EXPECT_EQ(stats.total_out, input.size());
+  EXPECT_EQ(stats.fast_bytes + stats.slow_bytes, input.size());
+  EXPECT_GT(stats.fast_bytes, stats.slow_bytes);
+  EXPECT_GT(stats.fast_calls, 0u);
+  EXPECT_GT(stats.fixed_blocks + stats.dynamic_blocks, 0u);
+  EXPECT_EQ(stats.table_builds, stats.dynamic_blocks);
+  EXPECT_EQ(stats.dictionary_requests, 0u);
+
+  // Byte at a time output: the fast loop never runs.
+  ASSERT_EQ(inflateReset(&stream), Z_OK);
+  stream.next_in = compressed.data();
+  stream.avail_in = compressed_size;
+  size_t out = 0;
+  do {
+    stream.next_out = output.data() + out;
+    stream.avail_out = 1;
+    ret = inflate(&stream, Z_NO_FLUSH);
+    out = stream.total_out;
+  } while (ret == Z_OK && out < output.size());
+  ASSERT_EQ(inflateGetStats(&stream, &stats), Z_OK);
+  EXPECT_EQ(stats.fast_bytes, 0u);
+  EXPECT_EQ(stats.slow_bytes, stream.total_out);
+  EXPECT_GT(stats.window_updates, 0u);
+  inflateEnd(&stream);
+
+  // inflateBack() does not maintain total_out, but counts its output too.
+  z_stream deflater = {};
+  ASSERT_EQ(deflateInit2(&deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                         Z_DEFAULT_STRATEGY),
+            Z_OK);
+  std::vector<uint8_t> raw(deflateBound(&deflater, input.size()));
+  deflater.next_in = const_cast<uint8_t*>(input.data());
+  deflater.avail_in = input.size();
+  deflater.next_out = raw.data();
+  deflater.avail_out = raw.size();
+  ASSERT_EQ(deflate(&deflater, Z_FINISH), Z_STREAM_END);
+  raw.resize(deflater.total_out);
+  deflateEnd(&deflater);
+
+  std::vector<uint8_t> window(32768);
+  z_stream back = {};
+  ASSERT_EQ(inflateBackInit(&back, 15, window.data()), Z_OK);
+  struct BackIo {
+    const std::vector<uint8_t>* in;
+    bool pulled;
+    std::vector<uint8_t> out;
+  } io = {&raw, false, {}};
+  auto pull = [](void* desc, z_const unsigned char** buf) -> unsigned {
+    BackIo* io = static_cast<BackIo*>(desc);
+    if (io->pulled)
+      return 0;
+    io->pulled = true;
+    *buf = const_cast<unsigned char*>(io->in->data());
+    return io->in->size();
+  };
+  auto push = [](void* desc, unsigned char* buf, unsigned len) -> int {
+    BackIo* io = static_cast<BackIo*>(desc);
+    io->out.insert(io->out.end(), buf, buf + len);
+    return 0;
+  };
+  ASSERT_EQ(inflateBack(&back, pull, &io, push, &io), Z_STREAM_END);
+  EXPECT_EQ(io.out, input);
+  ASSERT_EQ(inflateGetStats(&back, &stats), Z_OK);
+  EXPECT_EQ(stats.total_in, 0u);
+  EXPECT_EQ(stats.total_out, input.size());
+  EXPECT_EQ(stats.fast_bytes + stats.slow_bytes, input.size());
+  EXPECT_GT(stats.fast_bytes, stats.slow_bytes);
+  inflateBackEnd(&back);
+}
+
+TEST(ZlibTest, DeflateIncompressibleBypass) {
+  // Random data between stretches of text: the random parts are stored
+  // without matching once a block of them comes out stored, and the text
+  // after them is compressed again.
+  const size_t kRegion = 768 * 1024;
+  std::vector<uint8_t> input(4 * kRegion);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < input.size(); ++i) {
+    seed = seed * 1103515245 + 12345;
+    input[i] = (i / kRegion) % 2 ? static_cast<uint8_t>(seed >> 23)
+                                 : "zlib bypass test text. "[i % 23];
+  }
+
+  for (int level : {1, 6, 9}) {
+    for (int strategy : {Z_DEFAULT_STRATEGY, Z_FILTERED}) {
+      // Stream in small, odd sized pieces, with a sync flush now and then.
+      z_stream stream = {};
+      ASSERT_EQ(deflateInit2(&stream, level, Z_DEFLATED, -15, 8, strategy),
+                Z_OK);
+      std::vector<uint8_t> compressed(deflateBound(&stream, input.size()));
+      stream.next_in = input.data();
+      stream.next_out = compressed.data();
+      int ret = Z_OK;
+      for (int step = 0; ret != Z_STREAM_END; ++step) {
+        size_t left_in = input.data() + input.size() - stream.next_in;
+        stream.avail_in = std::min<size_t>(left_in, 40000 + step % 7 * 3001);
+        stream.avail_out = 1 + step % 5 * 7000;
+        int flush = stream.avail_in == left_in ? Z_FINISH
+                    : step % 13 == 0           ? Z_SYNC_FLUSH
+                                               : Z_NO_FLUSH;
+        ret = deflate(&stream, flush);
+        ASSERT_TRUE(ret == Z_OK || ret == Z_BUF_ERROR || ret == Z_STREAM_END);
+      }
+      size_t compressed_size = stream.total_out;
+      deflateEnd(&stream);
+
+      // The random halves cost about their size, the text next to nothing.
+      EXPECT_LT(compressed_size, input.size() / 2 + input.size() / 8);
+
+      std::vector<uint8_t> output(input.size());
+      stream = {};
+      ASSERT_EQ(inflateInit2(&stream, -15), Z_OK);
+      stream.next_in = compressed.data();
+      stream.avail_in = compressed_size;
+      stream.next_out = output.data();
+      stream.avail_out = output.size();
+      ASSERT_EQ(inflate(&stream, Z_FINISH), Z_STREAM_END);
+      EXPECT_EQ(stream.total_out, input.size());
+      inflateEnd(&stream);
+      EXPECT_EQ(output, input);
+    }
+  }
+
+  // Small writes without flushing are gathered into blocks of a worthy size
+  // before they are stored, rather than stored a write at a time.
+  std::vector<uint8_t> random(1024 * 1024);
+  for (size_t i = 0; i < random.size(); ++i) {
+    seed = seed * 1103515245 + 12345;
+    random[i] = static_cast<uint8_t>(seed >> 23);
+  }
+  z_stream stream = {};
+  ASSERT_EQ(deflateInit2(&stream, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY),
+            Z_OK);
+  std::vector<uint8_t> compressed(deflateBound(&stream, random.size()));
+  stream.next_in = random.data();
+  stream.next_out = compressed.data();
+  stream.avail_out = compressed.size();
+  int ret = Z_OK;
+  while (ret == Z_OK) {
+    size_t left_in = random.data() + random.size() - stream.next_in;
+    stream.avail_in = std::min<size_t>(left_in, 300);
+    ret = deflate(&stream, stream.avail_in == left_in ? Z_FINISH : Z_NO_FLUSH);
+  }
+  ASSERT_EQ(ret, Z_STREAM_END);
+  EXPECT_LE(stream.total_out, random.size() + random.size() / 1000);
+  deflateEnd(&stream);
+}
+
+TEST(ZlibTest, DeflateEstimate) {
+  // Random bytes are predicted stored, repetitive ones small, and the levels
+  // ranked.
+  z_deflate_estimate estimate;
+  std::vector<uint8_t> input(1024 * 1024);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < input.size(); ++i) {
+    seed = seed * 1103515245 + 12345;
+    input[i] = static_cast<uint8_t>(seed >> 23);
+  }
+  ASSERT_EQ(deflateEstimate(input.data(), input.size(), &estimate), Z_OK);
+  EXPECT_LT(estimate.sampled, input.size());
+  EXPECT_GT(estimate.entropy, 7900u);
+  for (int level = 1; level <= 9; ++level) {
+    EXPECT_GE(estimate.size[level], input.size());
+    EXPECT_LE(estimate.size[level], input.size() + input.size() / 1000);
+  }
+
+  // Random bytes repeating within a slice are not taken for incompressible,
+  // though their histogram is almost as flat.
+  for (size_t i = 2048; i < input.size(); ++i)
+    input[i] = input[i - 2048];
+  ASSERT_EQ(deflateEstimate(input.data(), input.size(), &estimate), Z_OK);
+  EXPECT_LT(estimate.size[6], input.size() / 2);
+
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = "the quick brown fox "[i % 20];
+  ASSERT_EQ(deflateEstimate(input.data(), input.size(), &estimate), Z_OK);
+  EXPECT_LT(estimate.entropy, 4000u);
+  EXPECT_LT(estimate.size[1], input.size() / 20);
+  for (int level = 1; level < 9; ++level)
+    EXPECT_GE(estimate.size[level], estimate.size[level + 1]);
+
+  // Small inputs are examined whole, and compared with the real size.
+  const size_t small = 16 * 1024;
+  for (size_t i = 0; i < small; ++i)
+    input[i] = static_cast<uint8_t>('a' + (i * i >> 7) % 13);
+  ASSERT_EQ(deflateEstimate(input.data(), small, &estimate), Z_OK);
+  EXPECT_EQ(estimate.sampled, small);
+  std::vector<uint8_t> compressed(compressBound(small));
+  uLongf compressed_size = compressed.size();
+  ASSERT_EQ(compress(compressed.data(), &compressed_size, input.data(), small),
+            Z_OK);
+  // The documented bound: 12% under to 35% over the compressed size.
+  EXPECT_GE(estimate.size[6] + 6, compressed_size - compressed_size * 12 / 100);
+  EXPECT_LE(estimate.size[6] + 6, compressed_size + compressed_size * 35 / 100);
+
+  // Matches running to the end of the input stop there, also when a later
+  // candidate would compare the byte past the end.
+  const char kTail[] = "xyzQxyzSSSSxyzSSSS";
+  std::vector<uint8_t> tail(kTail, kTail + sizeof(kTail) - 1);
+  ASSERT_EQ(deflateEstimate(tail.data(), tail.size(), &estimate), Z_OK);
+  EXPECT_EQ(estimate.sampled, tail.size());
+  tail.resize(300);
+  for (size_t i = 0; i < tail.size(); ++i)
+    tail[i] = static_cast<uint8_t>("abcab"[i % 5]);
+  ASSERT_EQ(deflateEstimate(tail.data(), tail.size(), &estimate), Z_OK);
+  EXPECT_LT(estimate.size[9], tail.size() / 4);
+
+  EXPECT_EQ(deflateEstimate(input.data(), 0, &estimate), Z_OK);
+  EXPECT_EQ(estimate.sampled, 0u);
+  EXPECT_EQ(deflateEstimate(nullptr, 1, &estimate), Z_STREAM_ERROR);
+  EXPECT_EQ(deflateEstimate(input.data(), 1, nullptr), Z_STREAM_ERROR);
+}
+
+TEST(ZlibTest, CompressHelperToSink) {
+  // Compress into a list of small chunks, the way a rope would be filled.
+  std::vector<uint8_t> input(100'000);
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = static_cast<uint8_t>((i * 7) % 251 + (i >> 10));
+
+  struct Rope {
+    std::vector<std::vector<uint8_t>> chunks;
+    size_t last_written = 0;
+    bool finished = false;
+  } rope;
+  auto next = [](void* opaque, size_t* size) -> Bytef* {
+    Rope* rope = static_cast<Rope*>(opaque);
+    rope->chunks.emplace_back(1000);
+    *size = rope->chunks.back().size();
+    return rope->chunks.back().data();
+  };
+  auto finish = [](void* opaque, size_t written) {
+    Rope* rope = static_cast<Rope*>(opaque);
+    rope->last_written = written;
+    rope->finished = true;
+  };
+  zlib_internal::OutputSink sink = {next, finish, &rope};
+
+  for (auto type : {zlib_internal::ZLIB, zlib_internal::GZIP,
+                    zlib_internal::ZRAW}) {
+    rope = Rope();
+    ASSERT_EQ(zlib_internal::CompressHelperToSink(
+                  type, input.data(), input.size(), Z_BEST_COMPRESSION, &sink,
+                  nullptr, nullptr),
+              Z_OK);
+    ASSERT_TRUE(rope.finished);
+    ASSERT_GT(rope.chunks.size(), 1u);
+    EXPECT_GT(rope.last_written, 0u);
+
+    std::vector<uint8_t> compressed;
+    for (const auto& chunk : rope.chunks)
+      compressed.insert(compressed.end(), chunk.begin(), chunk.end());
+    compressed.resize(compressed.size() - 1000 + rope.last_written);
+
+    std::vector<uint8_t> output(input.size());
+    uLongf output_size = output.size();
+    ASSERT_EQ(zlib_internal::UncompressHelper(type, output.data(), &output_size,
+                                              compressed.data(),
+                                              compressed.size()),
+              Z_OK);
+    EXPECT_EQ(output, input);
+  }
+
+  // A sink that runs out of memory fails the compression.
+  auto no_memory = [](void*, size_t*) -> Bytef* { return nullptr; };
+  zlib_internal::OutputSink failing = {no_memory, finish, &rope};
+  rope = Rope();
+  EXPECT_EQ(zlib_internal::GzipCompressHelperToSink(
+                input.data(), input.size(), &failing, nullptr, nullptr),
+            Z_MEM_ERROR);
+  EXPECT_FALSE(rope.finished);
+}
+
+TEST(ZlibTest, ParallelCompressHelperToSink) {
+  // Compressible input spanning a few chunks, with a partial last chunk.
+  const size_t kSize = zlib_internal::kParallelCompressThreshold +
+                       zlib_internal::kParallelCompressChunkSize / 2;
+  std::vector<uint8_t> input(kSize);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < kSize; ++i) {
+    seed = seed * 1103515245 + 12345;
+    input[i] = "abcdefgh"[(seed >> 16) & 7] + ((i >> 14) & 3);
+  }
+
+  // A sink that doubles a vector.
+  struct Growth {
+    std::vector<uint8_t> output;
+    size_t last_size = 0;
+  };
+  auto next = [](void* opaque, size_t* size) -> Bytef* {
+    Growth* growth = static_cast<Growth*>(opaque);
+    size_t used = growth->output.size();
+    *size = growth->last_size = used ? used : 4096;
+    growth->output.resize(used + *size);
+    return growth->output.data() + used;
+  };
+  auto finish = [](void* opaque, size_t written) {
+    Growth* growth = static_cast<Growth*>(opaque);
+    growth->output.resize(growth->output.size() - growth->last_size +
+                          written);
+  };
+
+  for (auto type : {zlib_internal::ZLIB, zlib_internal::GZIP,
+                    zlib_internal::ZRAW}) {
+    Growth growth;
+    zlib_internal::OutputSink sink = {next, finish, &growth};
+    ASSERT_EQ(zlib_internal::ParallelCompressHelperToSink(
+                  type, input.data(), input.size(), Z_DEFAULT_COMPRESSION, 4,
+                  &sink, nullptr, nullptr),
+              Z_OK);
+
+    // One ordinary stream, with valid check values.
+    std::vector<uint8_t> output(kSize);
+    uLongf output_size = output.size();
+    ASSERT_EQ(zlib_internal::UncompressHelper(
+                  type, output.data(), &output_size, growth.output.data(),
+                  growth.output.size()),
+              Z_OK);
+    EXPECT_EQ(output_size, kSize);
+    EXPECT_EQ(output, input);
+
+    // Close to the single-threaded compressed size.
+    std::vector<uint8_t> serial(
+        zlib_internal::GzipExpectedCompressedSize(kSize));
+    uLongf serial_size = serial.size();
+    ASSERT_EQ(zlib_internal::CompressHelper(type, serial.data(), &serial_size,
+                                            input.data(), input.size(),
+                                            Z_DEFAULT_COMPRESSION, nullptr,
+                                            nullptr),
+              Z_OK);
+    EXPECT_LT(growth.output.size(), serial_size + serial_size / 100);
+  }
+}
+
+TEST(ZlibTest, UncompressHelperToSink) {
+  std::vector<uint8_t> input(50'000);
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = static_cast<uint8_t>(i % 13);
+  std::vector<uint8_t> compressed(compressBound(input.size()));
+  uLongf compressed_size = compressed.size();
+  ASSERT_EQ(compress(compressed.data(), &compressed_size, input.data(),
+                     input.size()),
+            Z_OK);
+
+  // Output into 1000 byte chunks.
+  struct Chunks {
+    std::vector<std::vector<uint8_t>> chunks;
+    size_t last_written = 0;
+  } chunks;
+  auto next = [](void* opaque, size_t* size) -> Bytef* {
+    Chunks* chunks = static_cast<Chunks*>(opaque);
+    chunks->chunks.emplace_back(1000);
+    *size = 1000;
+    return chunks->chunks.back().data();
+  };
+  auto finish = [](void* opaque, size_t written) {
+    static_cast<Chunks*>(opaque)->last_written = written;
+  };
+  zlib_internal::OutputSink sink = {next, finish, &chunks};
+
+  size_t size;
+  bool truncated;
+  EXPECT_EQ(zlib_internal::UncompressHelperToSink(
+                zlib_internal::ZLIB, compressed.data(), compressed_size,
+                input.size(), &sink, &size, &truncated),
+            Z_OK);
+  EXPECT_EQ(size, input.size());
+  EXPECT_FALSE(truncated);
+  EXPECT_EQ(chunks.chunks.size(), 50u);
+  EXPECT_EQ(chunks.last_written, 1000u);
+
+  // Over the limit.
+  chunks = Chunks();
+  EXPECT_EQ(zlib_internal::UncompressHelperToSink(
+                zlib_internal::ZLIB, compressed.data(), compressed_size,
+                input.size() - 1, &sink, &size, &truncated),
+            Z_BUF_ERROR);
+  EXPECT_EQ(size, input.size() - 1);
+  EXPECT_EQ(chunks.last_written, 999u);
+
+  // Truncated.
+  chunks = Chunks();
+  EXPECT_EQ(zlib_internal::UncompressHelperToSink(
+                zlib_internal::ZLIB, compressed.data(), compressed_size - 1,
+                input.size(), &sink, &size, &truncated),
+            Z_DATA_ERROR);
+  EXPECT_TRUE(truncated);
+  EXPECT_EQ(size, input.size());
+}
+
+TEST(ZlibTest, UncompressHelperMultipleMembers) {
+  // Ten 256K members, as `cat` would join them.
+  const size_t kMemberSize = 256 * 1024;
+  const size_t kMembers = 10;
+  std::vector<uint8_t> input(kMemberSize * kMembers);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < input.size(); ++i) {
+    seed = seed * 1103515245 + 12345;
+    input[i] = "abcdefgh"[(seed >> 16) & 7] + ((i >> 14) & 3);
+  }
+  std::vector<uint8_t> compressed;
+  for (size_t i = 0; i < kMembers; ++i) {
+    std::vector<uint8_t> member(
+        zlib_internal::GzipExpectedCompressedSize(kMemberSize));
+    uLongf member_size = member.size();
+    ASSERT_EQ(zlib_internal::GzipCompressHelper(
+                  member.data(), &member_size, &input[i * kMemberSize],
+                  kMemberSize, nullptr, nullptr),
+              Z_OK);
+    compressed.insert(compressed.end(), member.begin(),
+                      member.begin() + member_size);
+  }
+  ASSERT_GE(compressed.size(), zlib_internal::kParallelUncompressThreshold);
+  // Only the last member's size is at the end of the input.
+  EXPECT_EQ(zlib_internal::GetGzipUncompressedSize(compressed.data(),
+                                                   compressed.size()),
+            kMemberSize);
+
+  std::vector<uint8_t> output(input.size());
+  uLongf output_size = output.size();
+  ASSERT_EQ(zlib_internal::GzipUncompressHelper(output.data(), &output_size,
+                                                compressed.data(),
+                                                compressed.size()),
+            Z_OK);
+  EXPECT_EQ(output_size, input.size());
+  EXPECT_EQ(output, input);
+
+  for (int threads : {2, 3, 16}) {
+    std::fill(output.begin(), output.end(), 0);
+    output_size = output.size();
+    ASSERT_EQ(zlib_internal::ParallelUncompressHelper(
+                  zlib_internal::GZIP, output.data(), &output_size,
+                  compressed.data(), compressed.size(), threads),
+              Z_OK);
+    EXPECT_EQ(output_size, input.size());
+    EXPECT_EQ(output, input);
+  }
+
+  // Trailing garbage throws off the last member's size, so the parallel
+  // helper falls back to decoding serially, which ignores it.
+  compressed.insert(compressed.end(), {0, 0, 0, 0, 0});
+  std::fill(output.begin(), output.end(), 0);
+  output_size = output.size();
+  ASSERT_EQ(zlib_internal::ParallelUncompressHelper(
+                zlib_internal::GZIP, output.data(), &output_size,
+                compressed.data(), compressed.size(), 4),
+            Z_OK);
+  EXPECT_EQ(output_size, input.size());
+  EXPECT_EQ(output, input);
+  compressed.resize(compressed.size() - 5);
+
+  // Too little space: the parallel helper says how much the members need.
+  output_size = output.size() - 1;
+  EXPECT_EQ(zlib_internal::ParallelUncompressHelper(
+                zlib_internal::GZIP, output.data(), &output_size,
+                compressed.data(), compressed.size(), 4),
+            Z_BUF_ERROR);
+  EXPECT_EQ(output_size, input.size());
+  output_size = output.size() - 1;
+  EXPECT_EQ(zlib_internal::GzipUncompressHelper(output.data(), &output_size,
+                                                compressed.data(),
+                                                compressed.size()),
+            Z_BUF_ERROR);
+
+  // A sink sees every member.
+  std::vector<uint8_t> sunk(input.size() + 1);
+  auto next = [](void* opaque, size_t* size) -> Bytef* {
+    std::vector<uint8_t>* sunk = static_cast<std::vector<uint8_t>*>(opaque);
+    *size = sunk->size();
+    return sunk->data();
+  };
+  auto finish = [](void* opaque, size_t written) {
+    static_cast<std::vector<uint8_t>*>(opaque)->resize(written);
+  };
+  zlib_internal::OutputSink sink = {next, finish, &sunk};
+  size_t size;
+  bool truncated;
+  ASSERT_EQ(zlib_internal::UncompressHelperToSink(
+                zlib_internal::GZIP, compressed.data(), compressed.size(),
+                sunk.size(), &sink, &size, &truncated),
+            Z_OK);
+  EXPECT_EQ(size, input.size());
+  EXPECT_EQ(sunk, input);
+}
+
+TEST(ZlibTest, GzipUncompressedSizeIgnoresHeaderLikeData) {
+  // A single member whose stored data looks like another member's header,
+  // followed by a large trailer-like size: the size still comes from the
+  // real trailer, and the member decodes into that much space.
+  std::vector<uint8_t> input(4096, 'a');
+  const uint8_t kFakeHeader[] = {0x1f, 0x8b, 8,    0,    0,    0,    0,
+                                 0,    0,    3,    0xff, 0xff, 0xff, 0x7f};
+  std::copy(std::begin(kFakeHeader), std::end(kFakeHeader),
+            input.begin() + 1000);
+  std::copy(std::begin(kFakeHeader), std::end(kFakeHeader),
+            input.end() - 40);
+
+  std::vector<uint8_t> compressed(
+      zlib_internal::GzipExpectedCompressedSize(input.size()));
+  uLongf compressed_size = compressed.size();
+  ASSERT_EQ(zlib_internal::CompressHelper(
+                zlib_internal::GZIP, compressed.data(), &compressed_size,
+                input.data(), input.size(), Z_NO_COMPRESSION, nullptr,
+                nullptr),
+            Z_OK);
+  compressed.resize(compressed_size);
+  uLongf size = zlib_internal::GetGzipUncompressedSize(compressed.data(),
+                                                       compressed.size());
+  ASSERT_EQ(size, input.size());
+
+  std::vector<uint8_t> output(size);
+  ASSERT_EQ(zlib_internal::GzipUncompressHelper(output.data(), &size,
+                                                compressed.data(),
+                                                compressed.size()),
+            Z_OK);
+  EXPECT_EQ(output, input);
+}
+
+namespace {
+int stream_cache_allocations = 0;
+int stream_cache_frees = 0;
+void* CountingMalloc(size_t size) {
+  ++stream_cache_allocations;
+  return malloc(size);
+}
+void CountingFree(void* address) {
+  ++stream_cache_frees;
+  free(address);
+}
+}  // namespace
+
+TEST(ZlibTest, StreamCache) {
+  std::vector<uint8_t> input(10'000);
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = static_cast<uint8_t>(i * 7 % 31);
+  std::vector<uint8_t> compressed(
+      zlib_internal::GzipExpectedCompressedSize(input.size()));
+  std::vector<uint8_t> output(input.size());
+
+  zlib_internal::SetStreamCacheEnabled(true);
+  stream_cache_allocations = stream_cache_frees = 0;
+  for (int round = 0; round < 3; ++round) {
+    for (auto type : {zlib_internal::ZLIB, zlib_internal::GZIP,
+                      zlib_internal::ZRAW}) {
+      for (int level : {1, 6, 9}) {
+        uLongf compressed_size = compressed.size();
+        ASSERT_EQ(zlib_internal::CompressHelper(
+                      type, compressed.data(), &compressed_size, input.data(),
+                      input.size(), level, CountingMalloc, CountingFree),
+                  Z_OK);
+        uLongf output_size = output.size();
+        ASSERT_EQ(zlib_internal::UncompressHelper(type, output.data(),
+                                                  &output_size,
+                                                  compressed.data(),
+                                                  compressed_size),
+                  Z_OK);
+        ASSERT_EQ(output_size, input.size());
+        ASSERT_EQ(output, input);
+      }
+    }
+  }
+  // Nine combinations cycle through four cached streams, so each call sets up
+  // a stream, but the streams outlive the calls.
+  EXPECT_GT(stream_cache_allocations, 0);
+  EXPECT_LT(stream_cache_frees, stream_cache_allocations);
+
+  // A repeated combination reuses its stream.
+  int allocations = stream_cache_allocations;
+  for (int i = 0; i < 10; ++i) {
+    uLongf compressed_size = compressed.size();
+    ASSERT_EQ(zlib_internal::CompressHelper(
+                  zlib_internal::GZIP, compressed.data(), &compressed_size,
+                  input.data(), input.size(), Z_DEFAULT_COMPRESSION,
+                  CountingMalloc, CountingFree),
+              Z_OK);
+  }
+  EXPECT_LE(stream_cache_allocations, allocations + 5);
+
+  // Disabling the cache frees every stream.
+  zlib_internal::SetStreamCacheEnabled(false);
+  EXPECT_EQ(stream_cache_frees, stream_cache_allocations);
+}
+
+TEST(ZlibTest, GzipHeaderOnePass) {
+  // A header with every optional field, and a header CRC.
+  Bytef extra[] = {'A', 'B', 3, 0, 1, 2, 3};
+  char name[] = "file.txt";
+  char comment[] = "a comment";
+  gz_header header;
+  memset(&header, 0, sizeof(header));
+  header.text = 1;
+  header.time = 0x12345678;
+  header.os = 3;
+  header.extra = extra;
+  header.extra_len = sizeof(extra);
+  header.name = reinterpret_cast<Bytef*>(name);
+  header.comment = reinterpret_cast<Bytef*>(comment);
+  header.hcrc = 1;
+
+  const char kData[] = "gzip header test";
+  std::vector<Bytef> compressed(256);
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  ASSERT_EQ(deflateInit2(&stream, 6, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY),
+            Z_OK);
+  ASSERT_EQ(deflateSetHeader(&stream, &header), Z_OK);
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(kData));
+  stream.avail_in = sizeof(kData);
+  stream.next_out = compressed.data();
+  stream.avail_out = compressed.size();
+  ASSERT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+  compressed.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  gzhdr_info info;
+  ASSERT_EQ(gzhdr_parse(compressed.data(), compressed.size(), &info),
+            GZHDR_OK);
+  EXPECT_EQ(info.time, 0x12345678u);
+  EXPECT_EQ(info.os, 3);
+  EXPECT_EQ(info.extra_len, sizeof(extra));
+  EXPECT_STREQ(reinterpret_cast<const char*>(&compressed[info.name]), name);
+  EXPECT_STREQ(reinterpret_cast<const char*>(&compressed[info.comment]),
+               comment);
+  EXPECT_TRUE(gzhdr_check_hcrc(compressed.data(), &info));
+  for (size_t length = 0; length < info.length; ++length) {
+    EXPECT_EQ(gzhdr_parse(compressed.data(), length, &info), GZHDR_MORE);
+  }
+
+  // inflate() reads the header in one pass when it is all there, and a byte at
+  // a time when it is not, with the same result.
+  for (uInt piece : {static_cast<uInt>(compressed.size()), 1u}) {
+    Bytef got_extra[4];
+    Bytef got_name[64];
+    Bytef got_comment[5];
+    gz_header got;
+    memset(&got, 0, sizeof(got));
+    got.extra = got_extra;
+    got.extra_max = sizeof(got_extra);
+    got.name = got_name;
+    got.name_max = sizeof(got_name);
+    got.comment = got_comment;
+    got.comm_max = sizeof(got_comment);
+
+    char output[sizeof(kData)];
+    memset(&stream, 0, sizeof(stream));
+    ASSERT_EQ(inflateInit2(&stream, 31), Z_OK);
+    ASSERT_EQ(inflateGetHeader(&stream, &got), Z_OK);
+    stream.next_in = compressed.data();
+    stream.next_out = reinterpret_cast<Bytef*>(output);
+    stream.avail_out = sizeof(output);
+    int err = Z_OK;
+    for (size_t offset = 0; err == Z_OK && offset < compressed.size();
+         offset += piece) {
+      stream.avail_in = std::min<size_t>(piece, compressed.size() - offset);
+      err = inflate(&stream, Z_NO_FLUSH);
+    }
+    EXPECT_EQ(err, Z_STREAM_END);
+    inflateEnd(&stream);
+    EXPECT_STREQ(output, kData);
+
+    EXPECT_EQ(got.done, 1);
+    EXPECT_EQ(got.text, 1);
+    EXPECT_EQ(got.time, 0x12345678u);
+    EXPECT_EQ(got.os, 3);
+    EXPECT_EQ(got.hcrc, 1);
+    EXPECT_EQ(got.extra_len, sizeof(extra));
+    EXPECT_EQ(memcmp(got_extra, extra, sizeof(got_extra)), 0);
+    EXPECT_STREQ(reinterpret_cast<char*>(got_name), name);
+    EXPECT_EQ(memcmp(got_comment, comment, sizeof(got_comment)), 0);
+  }
+
+  // A corrupt header CRC is still reported.
+  compressed[info.length - 1] ^= 1;
+  memset(&stream, 0, sizeof(stream));
+  ASSERT_EQ(inflateInit2(&stream, 31), Z_OK);
+  Bytef output[64];
+  stream.next_in = compressed.data();
+  stream.avail_in = compressed.size();
+  stream.next_out = output;
+  stream.avail_out = sizeof(output);
+  EXPECT_EQ(inflate(&stream, Z_NO_FLUSH), Z_DATA_ERROR);
+  EXPECT_STREQ(stream.msg, "header crc mismatch");
+  inflateEnd(&stream);
+}
+
+namespace {
+// Opens |tmp| from the start as a gzFile on a duplicate of its descriptor, so
+// that gzclose() leaves |tmp| open to be read back.
+gzFile GzDupOpen(FILE* tmp, const char* mode) {
+  fflush(tmp);
+  int fd = fileno(tmp);
+  if (lseek(fd, 0, SEEK_SET) != 0)
+    return nullptr;
+  return gzdopen(dup(fd), mode);
+}
+}  // namespace
+
+TEST(ZlibTest, GzGetline) {
+  // Lines are returned in place or gathered across output buffer refills, so
+  // read lines of all sizes through a small buffer.
+  FILE* tmp = tmpfile();
+  ASSERT_NE(tmp, nullptr);
+
+  std::vector<std::string> lines;
+  for (size_t length : {1, 2, 100, 2047, 2048, 2049, 5000, 70000, 3}) {
+    std::string line;
+    for (size_t i = 0; i + 1 < length; ++i)
+      line += static_cast<char>('a' + i % 26);
+    lines.push_back(line + '\n');
+  }
+  lines.push_back("no newline");
+
+  gzFile file = GzDupOpen(tmp, "wb");
+  ASSERT_NE(file, nullptr);
+  for (const std::string& line : lines)
+    ASSERT_EQ(gzwrite(file, line.data(), line.size()), (int)line.size());
+  ASSERT_EQ(gzclose(file), Z_OK);
+
+  file = GzDupOpen(tmp, "rb");
+  ASSERT_NE(file, nullptr);
+  ASSERT_EQ(gzbuffer(file, 1024), 0);
+  z_off_t pos = 0;
+  for (const std::string& line : lines) {
+    z_size_t length = 0;
+    const char* got = gzgetline(file, &length);
+    ASSERT_NE(got, nullptr);
+    EXPECT_EQ(std::string(got, length), line);
+    pos += length;
+    EXPECT_EQ(gztell(file), pos);
+  }
+  z_size_t length = 0;
+  EXPECT_EQ(gzgetline(file, &length), nullptr);
+  EXPECT_TRUE(gzeof(file));
+  int err;
+  gzerror(file, &err);
+  EXPECT_EQ(err, Z_OK);
+  EXPECT_EQ(gzclose(file), Z_OK);
+  fclose(tmp);
+}
+
+TEST(ZlibTest, GzPutIntAndTime) {
+  // Values are formatted into the input buffer, or through a scratch buffer
+  // when gzbuffer() makes it smaller than the longest value.
+  const z_off64_t ints[] = {0, 7, -7, 10, -4096, 1234567890};
+  const struct {
+    z_off64_t seconds;
+    const char* text;
+  } times[] = {
+      {0, "1970-01-01T00:00:00Z"},
+      {-1, "1969-12-31T23:59:59Z"},
+      {951782400, "2000-02-29T00:00:00Z"},
+      {1790000000, "2026-09-21T14:13:20Z"},
+      {-62167219200, "0000-01-01T00:00:00Z"},
+      {253402300799, "9999-12-31T23:59:59Z"},
+  };
+
+  for (unsigned buffer : {8u, 8192u}) {
+    FILE* tmp = tmpfile();
+    ASSERT_NE(tmp, nullptr);
+    gzFile file = GzDupOpen(tmp, "wb");
+    ASSERT_NE(file, nullptr);
+    ASSERT_EQ(gzbuffer(file, buffer), 0);
+    std::string expected;
+    for (int round = 0; round < 1000; ++round) {
+      for (z_off64_t value : ints) {
+        std::string text = std::to_string(value * (round + 1)) + " ";
+        ASSERT_EQ(gzputint(file, value * (round + 1)), (int)text.size() - 1);
+        ASSERT_EQ(gzputc(file, ' '), ' ');
+        expected += text;
+      }
+      for (const auto& time : times) {
+        ASSERT_EQ(gzputtime(file, time.seconds), 20);
+        ASSERT_EQ(gzputc(file, '\n'), '\n');
+        expected += std::string(time.text) + "\n";
+      }
+    }
+    EXPECT_EQ(gztell(file), (z_off_t)expected.size());
+    ASSERT_EQ(gzclose(file), Z_OK);
+
+    file = GzDupOpen(tmp, "rb");
+    ASSERT_NE(file, nullptr);
+    std::string got(expected.size() + 1, 0);
+    EXPECT_EQ(gzread(file, &got[0], got.size()), (int)expected.size());
+    got.resize(expected.size());
+    EXPECT_EQ(got, expected);
+    EXPECT_EQ(gzclose(file), Z_OK);
+    fclose(tmp);
+  }
+
+  // Times without a four digit year fail, and so does the file after that.
+  FILE* tmp = tmpfile();
+  ASSERT_NE(tmp, nullptr);
+  gzFile file = GzDupOpen(tmp, "wb");
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(gzputtime(file, 253402300800), -1);
+  int err;
+  gzerror(file, &err);
+  EXPECT_EQ(err, Z_STREAM_ERROR);
+  EXPECT_EQ(gzputint(file, 1), -1);
+  gzclose(file);
+  fclose(tmp);
+}
+
+namespace {
+std::string GzRecord(int thread, int index) {
+  // A line of 20 to about 1000 bytes that names its thread and index.
+  std::string record =
+      "t" + std::to_string(thread) + " r" + std::to_string(index) + " ";
+  record.append((thread * 7919 + index * 104729) % 1000, 'a' + index % 26);
+  return record + "\n";
+}
+}  // namespace
+
+TEST(ZlibTest, GzRecordWriterThreads) {
+  // Records appended from many threads at once come out whole, each thread's
+  // in order. The 64K buffer wraps often and fills up.
+  FILE* tmp = tmpfile();
+  ASSERT_NE(tmp, nullptr);
+  gzFile file = GzDupOpen(tmp, "wb1");
+  ASSERT_NE(file, nullptr);
+  zlib_internal::GzRecordWriter* writer =
+      zlib_internal::GzRecordWriterOpen(file, 0);
+  if (!writer) {
+    gzclose(file);
+    fclose(tmp);
+    GTEST_SKIP() << "GzRecordWriter needs pthreads";
+  }
+  std::string too_big(64 * 1024, 'x');
+  EXPECT_EQ(zlib_internal::GzRecordWriterAppend(writer, too_big.data(),
+                                                too_big.size()),
+            Z_BUF_ERROR);
+
+  const int kThreads = 8;
+  const int kRecords = 4000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([writer, t] {
+      for (int i = 0; i < kRecords; ++i) {
+        std::string record = GzRecord(t, i);
+        ASSERT_EQ(zlib_internal::GzRecordWriterAppend(writer, record.data(),
+                                                      record.size()),
+                  Z_OK);
+      }
+    });
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+  ASSERT_EQ(zlib_internal::GzRecordWriterClose(writer), Z_OK);
+
+  file = GzDupOpen(tmp, "rb");
+  ASSERT_NE(file, nullptr);
+  std::vector<int> next(kThreads, 0);
+  const char* line;
+  z_size_t length;
+  while ((line = gzgetline(file, &length)) != nullptr) {
+    int thread = -1, index = -1;
+    ASSERT_EQ(sscanf(line, "t%d r%d", &thread, &index), 2);
+    ASSERT_GE(thread, 0);
+    ASSERT_LT(thread, kThreads);
+    ASSERT_EQ(index, next[thread]);
+    ASSERT_EQ(std::string(line, length), GzRecord(thread, index));
+    ++next[thread];
+  }
+  EXPECT_EQ(gzclose(file), Z_OK);
+  fclose(tmp);
+  for (int t = 0; t < kThreads; ++t)
+    EXPECT_EQ(next[t], kRecords);
+}
+
 // TODO(gustavoa): make these tests run standalone.
 #ifndef CMAKE_STANDALONE_UNITTESTS
 
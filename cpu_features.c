@@ -9,6 +9,8 @@
 #include "zutil.h"
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #if defined(_MSC_VER)
 #include <intrin.h>
 #elif defined(ADLER32_SIMD_SSSE3)
@@ -36,8 +38,107 @@ int ZLIB_INTERNAL x86_cpu_enable_avx512 = 0;
 int ZLIB_INTERNAL riscv_cpu_enable_rvv = 0;
 int ZLIB_INTERNAL riscv_cpu_enable_vclmul = 0;
 
+int ZLIB_INTERNAL cpu_max_tier = CPU_TIER_MAX;
+
 #ifndef CPU_NO_SIMD
 
+/* The initial cpu_kernels entries: each checks the CPU features, which fills
+ * in the table, then calls the kernel chosen.
+ */
+static uLong crc32_resolve(uLong crc, const Bytef *buf, z_size_t len)
+{
+    cpu_check_features();
+    return cpu_kernels.crc32_fn(crc, buf, len);
+}
+
+static uLong adler32_resolve(uLong adler, const Bytef *buf, z_size_t len)
+{
+    cpu_check_features();
+    return cpu_kernels.adler32_fn(adler, buf, len);
+}
+
+static uLong adler32_copy_resolve(uLong adler, Bytef *dst, const Bytef *src,
+                                  z_size_t len)
+{
+    cpu_check_features();
+    return cpu_kernels.adler32_copy_fn(adler, dst, src, len);
+}
+
+static void copy_with_crc_resolve(z_streamp strm, Bytef *dst, long size)
+{
+    cpu_check_features();
+    cpu_kernels.copy_with_crc_fn(strm, dst, size);
+}
+
+struct cpu_kernels_s ZLIB_INTERNAL cpu_kernels = {
+    crc32_resolve,
+    adler32_resolve,
+    adler32_copy_resolve,
+    copy_with_crc_resolve,
+};
+
+/* The features found by _cpu_check_features(), before cpu_max_tier caps the
+ * cpu_enable flags above.
+ */
+#if defined(ARMV8_OS_MACOS)
+static int detected_arm_crc32 = 1;
+static int detected_arm_pmull = 1;
+#else
+static int detected_arm_crc32;
+static int detected_arm_pmull;
+#endif
+static int detected_x86_sse2;
+static int detected_x86_ssse3;
+static int detected_x86_simd;
+static int detected_x86_avx512;
+static int detected_riscv_rvv;
+
+static void cpu_save_features(void)
+{
+    detected_arm_crc32 = arm_cpu_enable_crc32;
+    detected_arm_pmull = arm_cpu_enable_pmull;
+    detected_x86_sse2 = x86_cpu_enable_sse2;
+    detected_x86_ssse3 = x86_cpu_enable_ssse3;
+    detected_x86_simd = x86_cpu_enable_simd;
+    detected_x86_avx512 = x86_cpu_enable_avx512;
+    detected_riscv_rvv = riscv_cpu_enable_rvv;
+}
+
+static void cpu_apply_max_tier(void)
+{
+    int tier = cpu_max_tier;
+    arm_cpu_enable_crc32 = detected_arm_crc32 && tier >= CPU_TIER_SSSE3;
+    arm_cpu_enable_pmull = detected_arm_pmull && tier >= CPU_TIER_SSE42;
+    x86_cpu_enable_sse2 = detected_x86_sse2 && tier >= CPU_TIER_SSSE3;
+    x86_cpu_enable_ssse3 = detected_x86_ssse3 && tier >= CPU_TIER_SSSE3;
+    x86_cpu_enable_simd = detected_x86_simd && tier >= CPU_TIER_SSE42;
+    x86_cpu_enable_avx512 = detected_x86_avx512 && tier >= CPU_TIER_AVX512;
+    riscv_cpu_enable_rvv = detected_riscv_rvv && tier >= CPU_TIER_SSSE3;
+}
+
+static void cpu_select_kernels(void)
+{
+    crc32_select_kernels(&cpu_kernels);
+    adler32_select_kernels(&cpu_kernels);
+}
+
+static int cpu_tier_from_env(void)
+{
+    static const char* const names[] = { "scalar", "ssse3", "sse42", "avx512" };
+    const char* value = getenv("ZLIB_CPU_MAX_TIER");
+    int tier;
+
+    if (value == NULL)
+        return CPU_TIER_MAX;
+    for (tier = CPU_TIER_SCALAR; tier <= CPU_TIER_MAX; tier++) {
+        if (!strcmp(value, names[tier]))
+            return tier;
+    }
+    if (value[0] >= '0' && value[0] <= '0' + CPU_TIER_MAX && !value[1])
+        return value[0] - '0';
+    return CPU_TIER_MAX;
+}
+
 #if defined(ARMV8_OS_ANDROID) || defined(ARMV8_OS_LINUX) || \
     defined(ARMV8_OS_FUCHSIA) || defined(ARMV8_OS_IOS)
 #include <pthread.h>
@@ -62,32 +163,41 @@ int ZLIB_INTERNAL riscv_cpu_enable_vclmul = 0;
 #error cpu_features.c CPU feature detection in not defined for your platform
 #endif
 
-#if !defined(CPU_NO_SIMD) && !defined(ARMV8_OS_MACOS)
+#if !defined(ARMV8_OS_MACOS)
 static void _cpu_check_features(void);
 #endif
 
+/* Called once: checks the CPU features, then caps them to the tier set in
+ * the environment, if any, and chooses the kernels.
+ */
+static void _cpu_init_features(void)
+{
+#if !defined(ARMV8_OS_MACOS)
+    _cpu_check_features();
+    cpu_save_features();
+#endif
+    cpu_max_tier = cpu_tier_from_env();
+    cpu_apply_max_tier();
+    cpu_select_kernels();
+}
+
 #if defined(ARMV8_OS_ANDROID) || defined(ARMV8_OS_LINUX) || \
     defined(ARMV8_OS_MACOS) || defined(ARMV8_OS_FUCHSIA) || \
     defined(X86_NOT_WINDOWS) || defined(ARMV8_OS_IOS) || \
     defined(RISCV_RVV)
-#if !defined(ARMV8_OS_MACOS)
 // _cpu_check_features() doesn't need to do anything on mac/arm since all
-// features are known at build time, so don't call it.
-// Do provide cpu_check_features() (with a no-op implementation) so that we
-// don't have to make all callers of it check for mac/arm.
+// features are known at build time, so _cpu_init_features() only applies the
+// tier and chooses the kernels there.
 static pthread_once_t cpu_check_inited_once = PTHREAD_ONCE_INIT;
-#endif
 void ZLIB_INTERNAL cpu_check_features(void)
 {
-#if !defined(ARMV8_OS_MACOS)
-    pthread_once(&cpu_check_inited_once, _cpu_check_features);
-#endif
+    pthread_once(&cpu_check_inited_once, _cpu_init_features);
 }
 #elif defined(ARMV8_OS_WINDOWS) || defined(X86_WINDOWS)
 static INIT_ONCE cpu_check_inited_once = INIT_ONCE_STATIC_INIT;
 static BOOL CALLBACK _cpu_check_features_forwarder(PINIT_ONCE once, PVOID param, PVOID* context)
 {
-    _cpu_check_features();
+    _cpu_init_features();
     return TRUE;
 }
 void ZLIB_INTERNAL cpu_check_features(void)
@@ -95,8 +205,39 @@ void ZLIB_INTERNAL cpu_check_features(void)
     InitOnceExecuteOnce(&cpu_check_inited_once, _cpu_check_features_forwarder,
                         NULL, NULL);
 }
+#else
+void ZLIB_INTERNAL cpu_check_features(void)
+{
+    cpu_select_kernels();
+}
 #endif
 
+int ZLIB_INTERNAL cpu_set_max_tier(int tier)
+{
+    cpu_check_features();
+    if (tier < CPU_TIER_SCALAR)
+        tier = CPU_TIER_SCALAR;
+    if (tier > CPU_TIER_MAX)
+        tier = CPU_TIER_MAX;
+    cpu_max_tier = tier;
+    cpu_apply_max_tier();
+    cpu_select_kernels();
+
+    if (x86_cpu_enable_avx512)
+        return CPU_TIER_AVX512;
+    if (x86_cpu_enable_simd || arm_cpu_enable_pmull)
+        return CPU_TIER_SSE42;
+    if (x86_cpu_enable_sse2 || x86_cpu_enable_ssse3 || arm_cpu_enable_crc32 ||
+        riscv_cpu_enable_rvv)
+        return CPU_TIER_SSSE3;
+#if defined(ADLER32_SIMD_NEON)
+    /* NEON is baseline on the targets built with it: only the tier gates it. */
+    if (tier >= CPU_TIER_SSSE3)
+        return CPU_TIER_SSSE3;
+#endif
+    return CPU_TIER_SCALAR;
+}
+
 #if (defined(__ARM_NEON__) || defined(__ARM_NEON))
 #if !defined(ARMV8_OS_MACOS)
 /*
@@ -157,8 +298,19 @@ static void _cpu_check_features(void)
  * (i.e. CPUID).
  */
 #ifdef CRC32_SIMD_AVX512_PCLMUL
-#include <immintrin.h>
-#include <xsaveintrin.h>
+/* Returns XCR0, the register states the OS saves on context switches. Inline
+ * assembly rather than _xgetbv(), which needs -mxsave with GCC.
+ */
+static uint64_t x86_xgetbv0(void)
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
 #endif
 static void _cpu_check_features(void)
 {
@@ -188,7 +340,20 @@ static void _cpu_check_features(void)
                           x86_cpu_has_pclmulqdq;
 
 #ifdef CRC32_SIMD_AVX512_PCLMUL
-    x86_cpu_enable_avx512 = _xgetbv(0) & 0x00000040;
+    /* The AVX-512 kernel needs AVX512F and VPCLMULQDQ from the CPU, and the
+     * OS to save the XMM, YMM, opmask and ZMM states, which it can only
+     * report with XGETBV when it has enabled XSAVE (OSXSAVE).
+     */
+    x86_cpu_enable_avx512 = 0;
+    if (x86_cpu_enable_simd && (abcd[2] & 0x8000000) &&
+        (x86_xgetbv0() & 0xe6) == 0xe6) {
+#ifdef _MSC_VER
+        __cpuidex(abcd, 7, 0);
+#else
+        __cpuid_count(7, 0, abcd[0], abcd[1], abcd[2], abcd[3]);
+#endif
+        x86_cpu_enable_avx512 = (abcd[1] & 0x10000) && (abcd[2] & 0x400);
+    }
 #endif
 }
 #endif // x86 & NO_SIMD
@@ -210,4 +375,10 @@ static void _cpu_check_features(void)
   riscv_cpu_enable_rvv = !!(features & ZLIB_HWCAP_RVV);
 }
 #endif // ARM | x86 | RISCV
+#else
+int ZLIB_INTERNAL cpu_set_max_tier(int tier)
+{
+    cpu_max_tier = tier;
+    return CPU_TIER_SCALAR;
+}
 #endif // NO SIMD CPU
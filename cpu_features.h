@@ -5,6 +5,9 @@
  * found in the Chromium source repository LICENSE file.
  */
 
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
 #include "zlib.h"
 
 /* TODO(cavalcantii): remove checks for x86_flags on deflate.
@@ -19,4 +22,68 @@ extern int x86_cpu_enable_avx512;
 extern int riscv_cpu_enable_rvv;
 extern int riscv_cpu_enable_vclmul;
 
+/* Function attributes enabling the instructions of each x86 kernel tier. The
+ * kernels are built with these rather than with -m flags on the command line,
+ * so the rest of zlib keeps the baseline instruction set and one binary runs
+ * on any x86 CPU, calling each kernel only when cpu_check_features() found its
+ * tier. MSVC allows intrinsics without flags.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_SSE42_PCLMUL __attribute__((target("sse4.2,pclmul")))
+#define TARGET_AVX512_PCLMUL \
+    __attribute__((target("avx512f,vpclmulqdq,sse4.2,pclmul")))
+#else
+#define TARGET_SSSE3
+#define TARGET_SSE42_PCLMUL
+#define TARGET_AVX512_PCLMUL
+#endif
+
+/* SIMD kernel tiers, lowest to highest. On x86 the tiers are SSE2/SSSE3
+ * (adler32, slide_hash, inflate chunk copy), SSE4.2+PCLMUL (crc32) and
+ * AVX-512 (crc32). On Arm, CPU_TIER_SSSE3 enables the NEON adler32 and the
+ * ARMv8 CRC32 kernels and CPU_TIER_SSE42 adds PMULL. On RISC-V, CPU_TIER_SSSE3 enables RVV.
+ */
+#define CPU_TIER_SCALAR 0
+#define CPU_TIER_SSSE3 1
+#define CPU_TIER_SSE42 2
+#define CPU_TIER_AVX512 3
+#define CPU_TIER_MAX CPU_TIER_AVX512
+
+/* Highest kernel tier zlib may use, CPU_TIER_MAX by default. It is set from
+ * the ZLIB_CPU_MAX_TIER environment variable (scalar, ssse3, sse42, avx512 or
+ * the tier number) when the CPU features are first checked at runtime.
+ */
+extern int cpu_max_tier;
+
 void cpu_check_features(void);
+
+/* Caps the kernel tier to |tier| and returns the highest tier the CPU will
+ * actually use. Intended for benchmarks and tests: it is not thread-safe with
+ * respect to other zlib calls in flight.
+ */
+int cpu_set_max_tier(int tier);
+
+/* The checksum kernels for the CPU, chosen from the cpu_enable flags when the
+ * features are first checked, and again by cpu_set_max_tier(). Until then each
+ * entry checks the features itself, so it is safe to call at any time. The
+ * hot entry points (crc32_z, adler32_z, copy_with_crc) call through the table
+ * rather than testing the flags on every call.
+ */
+struct cpu_kernels_s {
+    uLong (*crc32_fn)(uLong crc, const Bytef *buf, z_size_t len);
+    uLong (*adler32_fn)(uLong adler, const Bytef *buf, z_size_t len);
+    uLong (*adler32_copy_fn)(uLong adler, Bytef *dst, const Bytef *src,
+                             z_size_t len);
+    void (*copy_with_crc_fn)(z_streamp strm, Bytef *dst, long size);
+};
+
+extern struct cpu_kernels_s cpu_kernels;
+
+/* Fill in the entries of |kernels| for the functions of crc32.c and adler32.c
+ * from the current cpu_enable flags.
+ */
+void crc32_select_kernels(struct cpu_kernels_s *kernels);
+void adler32_select_kernels(struct cpu_kernels_s *kernels);
+
+#endif /* CPU_FEATURES_H */
@@ -671,6 +671,12 @@ unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
     return crc ^ 0xffffffff;
 }
 
+/* The kernel for CPUs without the run-time detected extensions. */
+local unsigned long crc32_generic(unsigned long crc,
+                                  const unsigned char FAR *buf, z_size_t len) {
+    return crc32_z(crc, buf, len);
+}
+
 #else
 
 #ifdef W
@@ -698,74 +704,9 @@ local z_word_t crc_word_big(z_word_t data) {
 #endif
 
 /* ========================================================================= */
-unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
-                              z_size_t len) {
-    /*
-     * zlib convention is to call crc32(0, NULL, 0); before making
-     * calls to crc32(). So this is a good, early (and infrequent)
-     * place to cache CPU features if needed for those later, more
-     * interesting crc32() calls.
-     */
-#if defined(CRC32_SIMD_SSE42_PCLMUL) || defined(CRC32_ARMV8_CRC32) \
-    || defined(RISCV_RVV)
-    /*
-     * Since this routine can be freely used, check CPU features here.
-     */
-    if (buf == Z_NULL) {
-        if (!len) /* Assume user is calling crc32(0, NULL, 0); */
-            cpu_check_features();
-        return 0UL;
-    }
-
-#endif
-#if defined(CRC32_SIMD_AVX512_PCLMUL)
-    if (x86_cpu_enable_avx512 && len >= Z_CRC32_AVX512_MINIMUM_LENGTH) {
-        /* crc32 64-byte chunks */
-        z_size_t chunk_size = len & ~Z_CRC32_AVX512_CHUNKSIZE_MASK;
-        crc = ~crc32_avx512_simd_(buf, chunk_size, ~(uint32_t)crc);
-        /* check remaining data */
-        len -= chunk_size;
-        if (!len)
-            return crc;
-        /* Fall into the default crc32 for the remaining data. */
-        buf += chunk_size;
-    }
-#elif defined(CRC32_SIMD_SSE42_PCLMUL)
-    if (x86_cpu_enable_simd && len >= Z_CRC32_SSE42_MINIMUM_LENGTH) {
-        /* crc32 16-byte chunks */
-        z_size_t chunk_size = len & ~Z_CRC32_SSE42_CHUNKSIZE_MASK;
-        crc = ~crc32_sse42_simd_(buf, chunk_size, ~(uint32_t)crc);
-        /* check remaining data */
-        len -= chunk_size;
-        if (!len)
-            return crc;
-        /* Fall into the default crc32 for the remaining data. */
-        buf += chunk_size;
-    }
-#elif defined(CRC32_ARMV8_CRC32)
-    if (arm_cpu_enable_crc32) {
-#if defined(__aarch64__)
-        /* PMULL is 64bit only, plus code needs at least a 64 bytes buffer. */
-        if (arm_cpu_enable_pmull && (len > Z_CRC32_PMULL_MINIMUM_LENGTH)) {
-            const size_t chunk_size = len & ~Z_CRC32_PMULL_CHUNKSIZE_MASK;
-            crc = ~armv8_crc32_pmull_little(buf, chunk_size, ~(uint32_t)crc);
-            /* Check remaining data. */
-            len -= chunk_size;
-            if (!len)
-                return crc;
-
-            /* Fall through for the remaining data. */
-            buf += chunk_size;
-        }
-#endif
-        return armv8_crc32_little(buf, len, crc); /* Armv8@32bit or tail. */
-    }
-#else
-    if (buf == Z_NULL) {
-        return 0UL;
-    }
-#endif /* CRC32_SIMD */
-
+/* The braided CRC, for any CPU. buf must not be Z_NULL. */
+local unsigned long crc32_generic(unsigned long crc,
+                                  const unsigned char FAR *buf, z_size_t len) {
 #ifdef DYNAMIC_CRC_TABLE
     once(&made, make_crc_table);
 #endif /* DYNAMIC_CRC_TABLE */
@@ -1081,45 +1022,149 @@ unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
 #endif
 
 /* ========================================================================= */
-unsigned long ZEXPORT crc32(unsigned long crc, const unsigned char FAR *buf,
-                            uInt len) {
-    /* Some bots compile with optimizations disabled, others will emulate
-     * ARM on x86 and other weird combinations.
-     */
+local void copy_with_crc_generic(z_streamp strm, Bytef *dst, long size) {
+    zmemcpy(dst, strm->next_in, size);
+    strm->adler = crc32_z(strm->adler, dst, size);
+}
+
+#if defined(CRC32_SIMD_SSE42_PCLMUL)
+/* Copies with the folding CRC that crc_reset() starts when it picks this
+ * kernel, and crc_finalize() reduces.
+ */
+local void copy_with_crc_fold(z_streamp strm, Bytef *dst, long size) {
+    crc_fold_copy(strm->state, dst, strm->next_in, size);
+}
+#endif
+
+/* ========================================================================= */
+/* The SIMD kernels compute the CRC of as many whole chunks as they can, and
+ * leave the remaining bytes to the next kernel down.
+ */
+#if defined(CRC32_SIMD_SSE42_PCLMUL)
+local unsigned long crc32_sse42(unsigned long crc,
+                                const unsigned char FAR *buf, z_size_t len) {
+    if (len >= Z_CRC32_SSE42_MINIMUM_LENGTH) {
+        /* crc32 16-byte chunks */
+        z_size_t chunk_size = len & ~Z_CRC32_SSE42_CHUNKSIZE_MASK;
+        crc = ~crc32_sse42_simd_(buf, chunk_size, ~(uint32_t)crc);
+        /* check remaining data */
+        len -= chunk_size;
+        if (!len)
+            return crc;
+        buf += chunk_size;
+    }
+    return crc32_generic(crc, buf, len);
+}
+#endif
+
+#if defined(CRC32_SIMD_AVX512_PCLMUL)
+local unsigned long crc32_avx512(unsigned long crc,
+                                 const unsigned char FAR *buf, z_size_t len) {
+    if (len >= Z_CRC32_AVX512_MINIMUM_LENGTH) {
+        /* crc32 64-byte chunks */
+        z_size_t chunk_size = len & ~Z_CRC32_AVX512_CHUNKSIZE_MASK;
+        crc = ~crc32_avx512_simd_(buf, chunk_size, ~(uint32_t)crc);
+        /* check remaining data */
+        len -= chunk_size;
+        if (!len)
+            return crc;
+        buf += chunk_size;
+    }
+    return crc32_sse42(crc, buf, len);
+}
+#endif
+
+#if defined(CRC32_ARMV8_CRC32)
+local unsigned long crc32_armv8(unsigned long crc,
+                                const unsigned char FAR *buf, z_size_t len) {
+    return armv8_crc32_little(buf, len, crc); /* Armv8@32bit or tail. */
+}
+
+#if defined(__aarch64__)
+local unsigned long crc32_armv8_pmull(unsigned long crc,
+                                      const unsigned char FAR *buf,
+                                      z_size_t len) {
+    /* PMULL is 64bit only, plus code needs at least a 64 bytes buffer. */
+    if (len > Z_CRC32_PMULL_MINIMUM_LENGTH) {
+        const size_t chunk_size = len & ~Z_CRC32_PMULL_CHUNKSIZE_MASK;
+        crc = ~armv8_crc32_pmull_little(buf, chunk_size, ~(uint32_t)crc);
+        /* Check remaining data. */
+        len -= chunk_size;
+        if (!len)
+            return crc;
+        buf += chunk_size;
+    }
+    return armv8_crc32_little(buf, len, crc);
+}
+#endif
+#endif
+
+/* ========================================================================= */
+void ZLIB_INTERNAL crc32_select_kernels(struct cpu_kernels_s *kernels) {
+    kernels->crc32_fn = crc32_generic;
+    kernels->copy_with_crc_fn = copy_with_crc_generic;
+#if defined(CRC32_SIMD_SSE42_PCLMUL)
+    if (x86_cpu_enable_simd) {
+        kernels->crc32_fn = crc32_sse42;
+        kernels->copy_with_crc_fn = copy_with_crc_fold;
+    }
+#if defined(CRC32_SIMD_AVX512_PCLMUL)
+    if (x86_cpu_enable_avx512)
+        kernels->crc32_fn = crc32_avx512;
+#endif
+#elif defined(CRC32_ARMV8_CRC32)
+    if (arm_cpu_enable_crc32)
+        kernels->crc32_fn = crc32_armv8;
+#if defined(__aarch64__)
+    if (arm_cpu_enable_crc32 && arm_cpu_enable_pmull)
+        kernels->crc32_fn = crc32_armv8_pmull;
+#endif
+#endif
+}
+
 #if defined(CRC32_SIMD_SSE42_PCLMUL) || defined(CRC32_ARMV8_CRC32) \
     || defined(RISCV_RVV)
-    /* We got to verify CPU features, so exploit the common usage pattern
-     * of calling this function with Z_NULL for an initial valid crc value.
-     * This allows to cache the result of the feature check and avoid extraneous
-     * function calls.
-     */
+#  define CRC32_DISPATCH
+#endif
+
+#ifndef ARMCRC32_CANONICAL_ZLIB
+/* ========================================================================= */
+unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
+                              z_size_t len) {
     if (buf == Z_NULL) {
-        if (!len) /* Assume user is calling crc32(0, NULL, 0); */
+#ifdef CRC32_DISPATCH
+        /*
+         * zlib convention is to call crc32(0, NULL, 0); before making
+         * calls to crc32(). So this is a good, early (and infrequent)
+         * place to cache CPU features if needed for those later, more
+         * interesting crc32() calls.
+         */
+        if (!len)
             cpu_check_features();
+#endif
         return 0UL;
     }
+#ifdef CRC32_DISPATCH
+    return cpu_kernels.crc32_fn(crc, buf, len);
+#else
+    return crc32_generic(crc, buf, len);
 #endif
-
-#if defined(CRC32_ARMV8_CRC32)
-    if (arm_cpu_enable_crc32) {
-#if defined(__aarch64__)
-        /* PMULL is 64bit only, plus code needs at least a 64 bytes buffer. */
-        if (arm_cpu_enable_pmull && (len > Z_CRC32_PMULL_MINIMUM_LENGTH)) {
-            const size_t chunk_size = len & ~Z_CRC32_PMULL_CHUNKSIZE_MASK;
-            crc = ~armv8_crc32_pmull_little(buf, chunk_size, ~(uint32_t)crc);
-            /* Check remaining data. */
-            len -= chunk_size;
-            if (!len)
-                return crc;
-
-            /* Fall through for the remaining data. */
-            buf += chunk_size;
-        }
+}
 #endif
-        return armv8_crc32_little(buf, len, crc); /* Armv8@32bit or tail. */
+
+/* ========================================================================= */
+unsigned long ZEXPORT crc32(unsigned long crc, const unsigned char FAR *buf,
+                            uInt len) {
+#ifdef CRC32_DISPATCH
+    if (buf == Z_NULL) {
+        if (!len) /* Assume user is calling crc32(0, NULL, 0); */
+            cpu_check_features();
+        return 0UL;
     }
+    return cpu_kernels.crc32_fn(crc, buf, len);
+#else
+    return crc32_z(crc, buf, len);
 #endif
-    return crc32_z(crc, buf, len); /* Armv7 or Armv8 w/o crypto extensions. */
 }
 
 /* ========================================================================= */
@@ -1152,13 +1197,21 @@ uLong ZEXPORT crc32_combine_op(uLong crc1, uLong crc2, uLong op) {
     return multmodp(op, crc1) ^ (crc2 & 0xffffffff);
 }
 
+/* crc_reset() takes the copy kernel from cpu_kernels once per gzip member,
+ * and copy_with_crc() and crc_finalize() stay with it, so that a
+ * cpu_set_max_tier() call mid-stream cannot mix the folding and the table CRC.
+ */
 ZLIB_INTERNAL void crc_reset(deflate_state *const s)
 {
 #ifdef CRC32_SIMD_SSE42_PCLMUL
-    if (x86_cpu_enable_simd) {
+    cpu_check_features();
+    s->crc_copy_fn = cpu_kernels.copy_with_crc_fn;
+    if (s->crc_copy_fn == copy_with_crc_fold) {
         crc_fold_init(s);
         return;
     }
+#else
+    s->crc_copy_fn = copy_with_crc_generic;
 #endif
     s->strm->adler = crc32(0L, Z_NULL, 0);
 }
@@ -1166,19 +1219,12 @@ ZLIB_INTERNAL void crc_reset(deflate_state *const s)
 ZLIB_INTERNAL void crc_finalize(deflate_state *const s)
 {
 #ifdef CRC32_SIMD_SSE42_PCLMUL
-    if (x86_cpu_enable_simd)
+    if (s->crc_copy_fn == copy_with_crc_fold)
         s->strm->adler = crc_fold_512to32(s);
 #endif
 }
 
 ZLIB_INTERNAL void copy_with_crc(z_streamp strm, Bytef *dst, long size)
 {
-#ifdef CRC32_SIMD_SSE42_PCLMUL
-    if (x86_cpu_enable_simd) {
-        crc_fold_copy(strm->state, dst, strm->next_in, size);
-        return;
-    }
-#endif
-    zmemcpy(dst, strm->next_in, size);
-    strm->adler = crc32(strm->adler, dst, size);
+    strm->state->crc_copy_fn(strm, dst, size);
 }
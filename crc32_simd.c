@@ -6,6 +6,8 @@
  */
 
 #include "crc32_simd.h"
+#include "cpu_features.h"
+
 #if defined(CRC32_SIMD_AVX512_PCLMUL)
 
 /*
@@ -21,6 +23,7 @@
 #include <wmmintrin.h>
 #include <immintrin.h>
 
+TARGET_AVX512_PCLMUL
 uint32_t ZLIB_INTERNAL crc32_avx512_simd_(  /* AVX512+PCLMUL */
     const unsigned char *buf,
     z_size_t len,
@@ -200,7 +203,10 @@ uint32_t ZLIB_INTERNAL crc32_avx512_simd_(  /* AVX512+PCLMUL */
     return _mm_extract_epi32(a1, 1);
 }
 
-#elif defined(CRC32_SIMD_SSE42_PCLMUL)
+#endif
+
+/* Builds with the AVX-512 kernel keep this one for CPUs without AVX-512. */
+#if defined(CRC32_SIMD_SSE42_PCLMUL)
 
 /*
  * crc32_sse42_simd_(): compute the crc32 of the buffer, where the buffer
@@ -211,6 +217,7 @@ uint32_t ZLIB_INTERNAL crc32_avx512_simd_(  /* AVX512+PCLMUL */
 #include <smmintrin.h>
 #include <wmmintrin.h>
 
+TARGET_SSE42_PCLMUL
 uint32_t ZLIB_INTERNAL crc32_sse42_simd_(  /* SSE4.2+PCLMUL */
     const unsigned char *buf,
     z_size_t len,
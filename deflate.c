@@ -52,6 +52,7 @@
 #include "deflate.h"
 
 #include "cpu_features.h"
+#include "zprobes.h"
 
 #if defined(DEFLATE_SLIDE_HASH_SSE2) || defined(DEFLATE_SLIDE_HASH_NEON)
 #include "slide_hash_simd.h"
@@ -96,6 +97,10 @@ extern void ZLIB_INTERNAL crc_reset(deflate_state *const s);
 extern void ZLIB_INTERNAL crc_finalize(deflate_state *const s);
 extern void ZLIB_INTERNAL copy_with_crc(z_streamp strm, Bytef *dst, long size);
 
+/* From adler32.c */
+extern uLong ZLIB_INTERNAL adler32_copy(uLong adler, Bytef *dst,
+                                       const Bytef *src, z_size_t len);
+
 /* ===========================================================================
  * Local data
  */
@@ -175,8 +180,10 @@ local const config configuration_table[10] = {
 #endif
 local void slide_hash(deflate_state *s) {
 #if defined(DEFLATE_SLIDE_HASH_SSE2) || defined(DEFLATE_SLIDE_HASH_NEON)
-    slide_hash_simd(s->head, s->prev, s->w_size, s->hash_size);
-    return;
+    if (cpu_max_tier >= CPU_TIER_SSSE3) {
+        slide_hash_simd(s->head, s->prev, s->w_size, s->hash_size);
+        return;
+    }
 #endif
 
     unsigned n, m;
@@ -225,11 +232,10 @@ local unsigned read_buf(z_streamp strm, Bytef *buf, unsigned size) {
         copy_with_crc(strm, buf, len);
     else
 #endif
-    {
+    if (strm->state->wrap == 1)
+        strm->adler = adler32_copy(strm->adler, buf, strm->next_in, len);
+    else
         zmemcpy(buf, strm->next_in, len);
-        if (strm->state->wrap == 1)
-            strm->adler = adler32(strm->adler, buf, len);
-    }
     strm->next_in  += len;
     strm->total_in += len;
 
@@ -275,6 +281,7 @@ local void fill_window(deflate_state *s) {
         if (s->strstart >= wsize + MAX_DIST(s)) {
 
             zmemcpy(s->window, s->window + wsize, (unsigned)wsize - more);
+            DEFLATE_STAT(s, window_slides, 1);
             s->match_start -= wsize;
             s->strstart    -= wsize; /* we now have strstart >= MAX_DIST */
             s->block_start -= (long) wsize;
@@ -395,6 +402,7 @@ int ZEXPORT deflateInit2_(z_streamp strm, int level, int method,
                           const char *version, int stream_size) {
     deflate_state *s;
     int wrap = 1;
+    int ret;
     static const char my_version[] = ZLIB_VERSION;
 
     // Needed to activate optimized insert_string() that helps compression
@@ -564,7 +572,10 @@ int ZEXPORT deflateInit2_(z_streamp strm, int level, int method,
     s->strategy = strategy;
     s->method = (Byte)method;
 
-    return deflateReset(strm);
+    ret = deflateReset(strm);
+    if (ret == Z_OK)
+        Z_PROBE5(deflate_init, strm, level, windowBits, memLevel, strategy);
+    return ret;
 }
 
 /* =========================================================================
@@ -671,6 +682,20 @@ int ZEXPORT deflateGetDictionary(z_streamp strm, Bytef *dictionary,
     return Z_OK;
 }
 
+/* ========================================================================= */
+int ZEXPORT deflateGetStats(z_streamp strm, z_deflate_stats *stats) {
+    if (deflateStateCheck(strm) || stats == Z_NULL)
+        return Z_STREAM_ERROR;
+#ifdef ZLIB_STATS
+    *stats = strm->state->stats;
+    stats->total_in = strm->total_in;
+    stats->total_out = strm->total_out;
+    return Z_OK;
+#else
+    return Z_STREAM_ERROR;
+#endif
+}
+
 /* ========================================================================= */
 int ZEXPORT deflateResetKeep(z_streamp strm) {
     deflate_state *s;
@@ -701,6 +726,9 @@ int ZEXPORT deflateResetKeep(z_streamp strm) {
 #endif
         adler32(0L, Z_NULL, 0);
     s->last_flush = -2;
+#ifdef ZLIB_STATS
+    zmemzero((Bytef *)&s->stats, sizeof(s->stats));
+#endif
 
     _tr_init(s);
 
@@ -729,6 +757,8 @@ local void lm_init(deflate_state *s) {
     s->match_length = s->prev_length = MIN_MATCH-1;
     s->match_available = 0;
     s->ins_h = 0;
+    s->bypass = 0;
+    s->bypass_span = BYPASS_SPAN_MIN;
 }
 
 /* ========================================================================= */
@@ -942,6 +972,264 @@ uLong ZEXPORT deflateBound(z_streamp strm, uLong sourceLen) {
            (sourceLen >> 25) + 13 - 6 + wraplen;
 }
 
+/* =========================================================================
+ * Sampling compressed size estimation, for deflateEstimate(). Slices of the
+ * input, the first at its start and the others spread evenly over the rest,
+ * are first only counted into a byte histogram: when that is as flat as random
+ * bytes make it, the input is taken as incompressible. Otherwise the
+ * slices are parsed greedily into literals and matches with a small hash
+ * table, once trying a few recent positions with the same hash, as the fast
+ * levels do, and once trying more, as the slower levels do. Each slice after
+ * the first is parsed with the bytes before it as history. The literal/length
+ * and distance codes are costed at their order-0 entropy in the slice, which
+ * is about what a dynamic block's Huffman codes achieve, plus their extra
+ * bits.
+ */
+#define EST_SAMPLES 8           /* most slices of a large input */
+#define EST_SAMPLE 4096         /* bytes in a slice */
+#define EST_SPAN 131072         /* input bytes per slice, for two or more */
+#define EST_WHOLE 32768         /* inputs up to this size are parsed whole */
+#define EST_HASH_BITS 10
+#define EST_FAST_WAYS 4         /* positions tried per hash, fast levels */
+#define EST_WAYS 16             /* and slow levels */
+#define EST_HISTORY 1024        /* bytes before a slice primed as history */
+/* The chi-squared statistic of the byte histogram against a flat one is 255
+   on average for random bytes, with a deviation of 23. Histograms of a slice
+   or more up to four deviations above that skip the parse. Bytes repeating at
+   a distance a slice can see score at least 255 per repeat sampled. */
+#define EST_FLAT 345
+
+/* The hash bucket of the three bytes at p in a table of 2^bits buckets of
+   ways positions each, and adding position pos to a bucket. */
+#define EST_BUCKET(head, p, bits, ways) \
+    (head + ((((unsigned)(p)[0] | ((unsigned)(p)[1] << 8) | \
+               ((unsigned)(p)[2] << 16)) * 2654435761U) >> (32 - (bits))) * \
+            (ways))
+#define EST_INSERT(bucket, ways, pos) \
+    do { \
+        unsigned way_; \
+        for (way_ = (ways) - 1; way_ > 0; way_--) \
+            (bucket)[way_] = (bucket)[way_ - 1]; \
+        (bucket)[0] = (ush)((pos) + 1); \
+    } while (0)
+
+/* 256 * log2(x), to within 0.09 bits, for 0 < x < 2^24. */
+local unsigned est_log2(unsigned x) {
+    unsigned n = 0;
+
+    if (x >> 16) n += 16;
+    if (x >> (n + 8)) n += 8;
+    if (x >> (n + 4)) n += 4;
+    if (x >> (n + 2)) n += 2;
+    if (x >> (n + 1)) n += 1;
+    return (n << 8) + (((x << 8) >> n) - 256);
+}
+
+/* Returns the cost in bits of Huffman coding the n symbol frequencies in
+   freq, at their entropy plus a bit for each symbol used to describe the
+   code. */
+local z_size_t est_entropy(const unsigned *freq, unsigned n) {
+    z_size_t q8 = 0, bits = 0;
+    unsigned total = 0, log_total, k;
+
+    for (k = 0; k < n; k++)
+        total += freq[k];
+    if (total == 0)
+        return 0;
+    log_total = est_log2(total);
+    for (k = 0; k < n; k++) {
+        if (freq[k]) {
+            q8 += (z_size_t)freq[k] * (log_total - est_log2(freq[k]));
+            bits++;
+        }
+    }
+    return bits + q8 / 256;
+}
+
+/* Returns the estimated deflate cost in bits of buf[start..len), len <=
+   65535, parsed with up to ways candidate positions per hash. The bytes before
+   start are only history for the matches. */
+local z_size_t est_parse(const Bytef *buf, unsigned start, unsigned len,
+                         unsigned ways) {
+    ush head[(1 << EST_HASH_BITS) * EST_WAYS];
+    ush *bucket;
+    unsigned freq[L_CODES], dfreq[D_CODES];
+    z_size_t bits = 0;
+    unsigned i, w, n, limit, best, dist, insert, p, code, hash_bits;
+
+    /* One bucket for every two to four bytes, so that only the part of the
+       table a small input can fill needs to be cleared. */
+    for (hash_bits = 4; hash_bits < EST_HASH_BITS &&
+                        (len >> (hash_bits + 2)) != 0; hash_bits++)
+        ;
+    zmemzero(head, ((z_size_t)ways << hash_bits) * sizeof(ush));
+    zmemzero(freq, sizeof(freq));
+    zmemzero(dfreq, sizeof(dfreq));
+    for (i = 0; i < start && i + 3 < len; i++) {
+        bucket = EST_BUCKET(head, buf + i, hash_bits, ways);
+        EST_INSERT(bucket, ways, i);
+    }
+    i = start;
+    while (i + 3 < len) {
+        best = 2;
+        dist = 0;
+        limit = len - i < MAX_MATCH ? len - i : MAX_MATCH;
+        bucket = EST_BUCKET(head, buf + i, hash_bits, ways);
+        /* stop at limit: no candidate can be longer, and buf[i + limit] may
+           be past the end */
+        for (w = 0; w < ways && best < limit && bucket[w]; w++) {
+            p = bucket[w] - 1;
+            /* as longest_match() does, skip candidates that cannot be longer */
+            if (buf[p + best] != buf[i + best] || buf[p] != buf[i] ||
+                buf[p + 1] != buf[i + 1])
+                continue;
+            for (n = 2; n < limit && buf[p + n] == buf[i + n]; n++)
+                ;
+            if (n > best) {
+                best = n;
+                dist = i - p;
+            }
+        }
+        EST_INSERT(bucket, ways, i);
+
+        if (dist && (best > 3 || dist <= 4096)) {
+            /* tally the codes as _tr_tally() does, and add their extra bits */
+            code = _length_code[best - MIN_MATCH];
+            freq[code + LITERALS + 1]++;
+            if (code >= 8 && code < LENGTH_CODES - 1)
+                bits += (code - 4) / 4;
+            code = d_code(dist - 1);
+            dfreq[code]++;
+            if (code >= 4)
+                bits += (code - 2) / 2;
+            /* the slow levels hash every position, the fast ones only those
+               in short matches */
+            if (ways == EST_WAYS || best <= 4) {
+                for (insert = i + 1; insert < i + best && insert + 3 < len;
+                     insert++) {
+                    bucket = EST_BUCKET(head, buf + insert, hash_bits, ways);
+                    EST_INSERT(bucket, ways, insert);
+                }
+            }
+            i += best;
+        }
+        else
+            freq[buf[i++]]++;
+    }
+    while (i < len)
+        freq[buf[i++]]++;
+
+    return bits + est_entropy(freq, L_CODES) + est_entropy(dfreq, D_CODES);
+}
+
+/* Scales bits for sampled bytes to bytes for len bytes, capped at stored. */
+local z_size_t est_scale(z_size_t bits, z_size_t sampled, z_size_t len,
+                         z_size_t stored) {
+    z_size_t rate;
+
+    /* 256 * bits per byte, with the block header and end of block code */
+    rate = (bits + 10) * 256 / sampled;
+    if (rate >= 8 * 256)
+        return stored;
+    len = len / 2048 * rate + len % 2048 * rate / 2048 + 1;
+    return len < stored ? len : stored;
+}
+
+int ZEXPORT deflateEstimate(const Bytef *source, z_size_t sourceLen,
+                            z_deflate_estimate *estimate) {
+    unsigned hist[256];
+    unsigned samples, length, n;
+    int level;
+    z_size_t first, step, i, sampled = 0, fast = 0, slow = 0, stored, q8;
+    z_size_t squares = 0;
+    z_size_t fast0, slow0;
+    const Bytef *sample;
+
+    if (estimate == Z_NULL || (source == Z_NULL && sourceLen))
+        return Z_STREAM_ERROR;
+    zmemzero(estimate, sizeof(z_deflate_estimate));
+    zmemzero(hist, sizeof(hist));
+
+    if (sourceLen <= EST_WHOLE) {
+        samples = 1;
+        length = (unsigned)sourceLen;
+        first = step = 0;
+    }
+    else {
+        /* a fixed fraction of the input, within two to EST_SAMPLES slices:
+           the first starts the input, as the stream does, and the others are
+           each in the middle of their share of the rest, which they stand
+           for */
+        samples = sourceLen / EST_SPAN < EST_SAMPLES ?
+                  (unsigned)(sourceLen / EST_SPAN) : EST_SAMPLES;
+        if (samples < 2)
+            samples = 2;
+        length = EST_SAMPLE;
+        step = (sourceLen - EST_SAMPLE) / (samples - 1);
+        first = EST_SAMPLE + (step - EST_SAMPLE) / 2;
+    }
+    for (n = 0; n < samples; n++) {
+        sample = source + (n ? first + (n - 1) * step : 0);
+        for (i = 0; i < length; i++)
+            hist[sample[i]]++;
+        sampled += length;
+    }
+    estimate->sampled = sampled;
+
+    /* Level 0 emits stored blocks of up to 64K, and the other levels emit a
+       stored block for any block of about 16K that does not compress. */
+    estimate->size[0] = sourceLen + 5 * (sourceLen / 65535 + 1);
+    if (sampled == 0) {
+        for (level = 1; level <= 9; level++)
+            estimate->size[level] = 2;
+        return Z_OK;
+    }
+    q8 = 0;
+    for (n = 0; n < 256; n++)
+        if (hist[n]) {
+            q8 += (z_size_t)hist[n] *
+                  (est_log2((unsigned)sampled) - est_log2(hist[n]));
+            squares += (z_size_t)hist[n] * hist[n];
+        }
+    q8 = q8 * 1000 / 256 / sampled;
+    estimate->entropy = q8 > 8000 ? 8000 : (unsigned)q8;   /* log2 error */
+
+    stored = sourceLen + 5 * (sourceLen / 16384 + 1);
+    /* chi-squared = 256 * squares / sampled - sampled */
+    if (sampled >= EST_SAMPLE &&
+        256 * squares <= sampled * (sampled + EST_FLAT)) {
+        for (level = 1; level <= 9; level++)
+            estimate->size[level] = stored;
+        return Z_OK;
+    }
+    fast0 = est_parse(source, 0, length, EST_FAST_WAYS);
+    slow0 = est_parse(source, 0, length, EST_WAYS);
+    if (samples == 1) {
+        fast = est_scale(fast0, length, sourceLen, stored);
+        slow = est_scale(slow0, length, sourceLen, stored);
+    }
+    else {
+        for (n = 1; n < samples; n++) {
+            /* parse each slice after the EST_HISTORY bytes before it */
+            sample = source + first + (n - 1) * step - EST_HISTORY;
+            fast += est_parse(sample, EST_HISTORY, EST_HISTORY + length,
+                              EST_FAST_WAYS);
+            slow += est_parse(sample, EST_HISTORY, EST_HISTORY + length,
+                              EST_WAYS);
+        }
+        fast = (fast0 + 7) / 8 + est_scale(fast, sampled - length,
+                                           sourceLen - length, stored);
+        slow = (slow0 + 7) / 8 + est_scale(slow, sampled - length,
+                                           sourceLen - length, stored);
+        fast = fast < stored ? fast : stored;
+        slow = slow < stored ? slow : stored;
+    }
+    for (level = 1; level <= 9; level++)
+        estimate->size[level] = level <= 3 ? fast :
+                                level <= 5 ? (fast + 2 * slow) / 3 : slow;
+    return Z_OK;
+}
+
 /* =========================================================================
  * Put a short in the pending buffer. The 16-bit value is put in MSB order.
  * IN assertion: the stream state is correct and there is enough room in
@@ -1306,6 +1594,7 @@ int ZEXPORT deflateEnd(z_streamp strm) {
     int status;
 
     if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    Z_PROBE3(deflate_end, strm, strm->total_in, strm->total_out);
 
     status = strm->state->status;
 
@@ -1450,6 +1739,7 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
 
     do {
         Assert(cur_match < s->strstart, "no future");
+        DEFLATE_STAT(s, chain_steps, 1);
         match = s->window + cur_match;
 
         /* Skip to next match if the match length cannot increase
@@ -1650,16 +1940,38 @@ local void check_match(deflate_state *s, IPos start, IPos match, int length) {
 #  define check_match(s, start, match, length)
 #endif /* ZLIB_DEBUG */
 
+/* ===========================================================================
+ * Incompressible data bypass. When a block of at least BYPASS_BLOCK bytes is
+ * emitted stored, the input is most likely compressed or encrypted already,
+ * and hashing and matching what follows is wasted work. deflate_fast() and
+ * deflate_slow() then copy the next s->bypass_span bytes into stored blocks
+ * with deflate_bypass(), and compress the block after that as usual, as a
+ * probe. If the probe is stored too the span doubles, up to BYPASS_SPAN_MAX,
+ * and if not the span goes back to BYPASS_SPAN_MIN. So at most
+ * BYPASS_SPAN_MAX bytes of compressible data following incompressible data
+ * are stored before matching resumes.
+ */
+local void bypass_update(deflate_state *s, ulg stored_len) {
+    if (!s->block_stored) {
+        s->bypass_span = BYPASS_SPAN_MIN;
+    } else if (stored_len >= BYPASS_BLOCK) {
+        s->bypass = s->bypass_span;
+        if (s->bypass_span < BYPASS_SPAN_MAX)
+            s->bypass_span <<= 1;
+    }
+}
+
 /* ===========================================================================
  * Flush the current block, with given end-of-file flag.
  * IN assertion: strstart is set to the end of the current match.
  */
 #define FLUSH_BLOCK_ONLY(s, last) { \
+   ulg stored_len_ = (ulg)((long)s->strstart - s->block_start); \
    _tr_flush_block(s, (s->block_start >= 0L ? \
                    (charf *)&s->window[(unsigned)s->block_start] : \
                    (charf *)Z_NULL), \
-                (ulg)((long)s->strstart - s->block_start), \
-                (last)); \
+                stored_len_, (last)); \
+   bypass_update(s, stored_len_); \
    s->block_start = s->strstart; \
    flush_pending(s->strm); \
    Tracev((stderr,"[FLUSH]")); \
@@ -1798,6 +2110,7 @@ local block_state deflate_stored(deflate_state *s, int flush) {
                 /* Slide the window down. */
                 s->strstart -= s->w_size;
                 zmemcpy(s->window, s->window + s->w_size, s->strstart);
+                DEFLATE_STAT(s, window_slides, 1);
                 if (s->matches < 2)
                     s->matches++;   /* add a pending slide_hash() */
                 if (s->insert > s->strstart)
@@ -1828,6 +2141,7 @@ local block_state deflate_stored(deflate_state *s, int flush) {
         s->block_start -= s->w_size;
         s->strstart -= s->w_size;
         zmemcpy(s->window, s->window + s->w_size, s->strstart);
+        DEFLATE_STAT(s, window_slides, 1);
         if (s->matches < 2)
             s->matches++;           /* add a pending slide_hash() */
         have += s->w_size;          /* more space now */
@@ -1869,6 +2183,52 @@ local block_state deflate_stored(deflate_state *s, int flush) {
     return last ? finish_started : need_more;
 }
 
+/* ===========================================================================
+ * Store the window from block_start to the end of the lookahead, or s->bypass
+ * bytes of it if less, without looking for matches. The stored bytes are not
+ * inserted in the hash table. As deflate_stored() does, wait until a worthy
+ * block of min_block bytes is in the window, or the window is full, unless
+ * flushing, so that small input buffers do not make small stored blocks.
+ * Returns true if next_out is full, or if more input is needed.
+ * IN assertion: no symbols have been tallied since block_start, so the window
+ * holds all of the current block.
+ */
+local int deflate_bypass(deflate_state *s, int flush) {
+    unsigned min_block = MIN(s->pending_buf_size - 5, s->w_size);
+    ulg len, room;
+
+    Assert(s->sym_next == 0, "bypass with tallied symbols");
+    len = s->strstart + s->lookahead - s->block_start;
+    if (len < min_block && flush == Z_NO_FLUSH &&
+        s->strstart + s->lookahead < s->window_size) {
+        if (s->strm->avail_in == 0)
+            return 1;
+        fill_window(s);
+        return 0;
+    }
+    room = s->pending_buf_size - s->pending - ((s->bi_valid + 42) >> 3);
+    len = MIN(len, MIN(room, MAX_STORED));
+    len = MIN(len, s->bypass);
+    _tr_stored_block(s, (charf *)s->window + s->block_start, len, 0);
+    DEFLATE_STAT(s, bypassed, len);
+    s->bypass -= len;
+    s->block_start += len;
+    s->lookahead -= (uInt)(s->block_start - s->strstart);
+    s->strstart = (uInt)s->block_start;
+    s->match_length = s->prev_length = MIN_MATCH-1;
+    s->match_available = 0;
+    s->insert = 0;
+    if (!s->chromium_zlib_hash && s->lookahead >= MIN_MATCH) {
+        s->ins_h = s->window[s->strstart];
+        UPDATE_HASH(s, s->ins_h, s->window[s->strstart + 1]);
+#if MIN_MATCH != 3
+        Call UPDATE_HASH() MIN_MATCH-3 more times
+#endif
+    }
+    flush_pending(s->strm);
+    return s->strm->avail_out == 0;
+}
+
 /* ===========================================================================
  * Compress as much as possible from the input stream, return the current
  * block state.
@@ -1894,6 +2254,15 @@ local block_state deflate_fast(deflate_state *s, int flush) {
             if (s->lookahead == 0) break; /* flush the current block */
         }
 
+        /* Store incompressible data without matching it, see
+         * bypass_update().
+         */
+        if (s->bypass && s->sym_next == 0) {
+            if (deflate_bypass(s, flush))
+                return need_more;
+            continue;
+        }
+
         /* Insert the string window[strstart .. strstart + 2] in the
          * dictionary, and set hash_head to the head of the hash chain:
          */
@@ -1997,6 +2366,15 @@ local block_state deflate_slow(deflate_state *s, int flush) {
             if (s->lookahead == 0) break; /* flush the current block */
         }
 
+        /* Store incompressible data without matching it, see
+         * bypass_update().
+         */
+        if (s->bypass && s->sym_next == 0) {
+            if (deflate_bypass(s, flush))
+                return need_more;
+            continue;
+        }
+
         /* Insert the string window[strstart .. strstart + 2] in the
          * dictionary, and set hash_head to the head of the hash chain:
          */
@@ -114,6 +114,8 @@ typedef struct internal_state {
     Byte  method;        /* can only be DEFLATED */
     int   last_flush;    /* value of flush param for previous deflate call */
     unsigned crc0[4 * 5];
+    void (*crc_copy_fn)(z_streamp strm, Bytef *dst, long size);
+    /* copy_with_crc() kernel chosen by crc_reset(), which set up crc0 for it */
     /* used by deflate.c: */
 
     uInt  w_size;        /* LZ77 window size (32K by default) */
@@ -282,8 +284,33 @@ typedef struct internal_state {
      * hash is enabled.
      */
 
+    ulg bypass;
+    /* Bytes still to be stored without looking for matches, because the data
+     * has proved incompressible; see bypass_update() in deflate.c.
+     */
+
+    ulg bypass_span;
+    /* Bytes to store after the next block that proves incompressible. */
+
+    int block_stored;
+    /* Set by _tr_flush_block() when it emitted the block stored. */
+
+#ifdef ZLIB_STATS
+    z_deflate_stats stats;
+    /* Counters returned by deflateGetStats(), see DEFLATE_STAT() below. */
+#endif
+
 } FAR deflate_state;
 
+#ifdef ZLIB_STATS
+#  define DEFLATE_STAT(s, counter, n) ((s)->stats.counter += (n))
+#else
+#  define DEFLATE_STAT(s, counter, n)
+#endif
+/* Add n to a deflateGetStats() counter: compiles to nothing without
+ * ZLIB_STATS.
+ */
+
 /* Output a byte on the stream.
  * IN assertion: there is enough room in pending_buf.
  */
@@ -304,6 +331,15 @@ typedef struct internal_state {
 /* Number of bytes after end of data in window to initialize in order to avoid
    memory checker errors from longest match routines */
 
+#define BYPASS_BLOCK 4096
+/* Size of a stored block that proves the data incompressible. */
+
+#define BYPASS_SPAN_MIN 65536L
+#define BYPASS_SPAN_MAX 262144L
+/* Bytes stored without matching after the first such block, and after
+ * several in a row. See bypass_update() in deflate.c.
+ */
+
         /* in trees.c */
 void ZLIB_INTERNAL _tr_init(deflate_state *s);
 int ZLIB_INTERNAL _tr_tally(deflate_state *s, unsigned dist, unsigned lc);
@@ -338,6 +374,7 @@ void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
     s->d_buf[s->sym_next] = 0; \
     s->l_buf[s->sym_next++] = cc; \
     s->dyn_ltree[cc].Freq++; \
+    DEFLATE_STAT(s, literals, 1); \
     flush = (s->sym_next == s->sym_end); \
    }
 # define _tr_tally_dist(s, distance, length, flush) \
@@ -348,6 +385,8 @@ void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
     dist--; \
     s->dyn_ltree[_length_code[len]+LITERALS+1].Freq++; \
     s->dyn_dtree[d_code(dist)].Freq++; \
+    DEFLATE_STAT(s, matches, 1); \
+    DEFLATE_STAT(s, match_bytes, (length) + MIN_MATCH); \
     flush = (s->sym_next == s->sym_end); \
   }
 #else
@@ -357,6 +396,7 @@ void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
     s->sym_buf[s->sym_next++] = 0; \
     s->sym_buf[s->sym_next++] = cc; \
     s->dyn_ltree[cc].Freq++; \
+    DEFLATE_STAT(s, literals, 1); \
     flush = (s->sym_next == s->sym_end); \
    }
 # define _tr_tally_dist(s, distance, length, flush) \
@@ -368,6 +408,8 @@ void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
     dist--; \
     s->dyn_ltree[_length_code[len]+LITERALS+1].Freq++; \
     s->dyn_dtree[d_code(dist)].Freq++; \
+    DEFLATE_STAT(s, matches, 1); \
+    DEFLATE_STAT(s, match_bytes, (length) + MIN_MATCH); \
     flush = (s->sym_next == s->sym_end); \
   }
 #endif
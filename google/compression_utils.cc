@@ -4,6 +4,11 @@
 
 #include "third_party/zlib/google/compression_utils.h"
 
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
 #include "base/check_op.h"
 #include "base/process/memory.h"
 
@@ -11,6 +16,123 @@
 
 namespace compression {
 
+namespace {
+
+// Whether |size| bytes can be passed to the helpers as a uLong, which is only
+// 32 bits on LLP64 platforms.
+bool FitsInULong(size_t size) {
+  return size <= std::numeric_limits<uLong>::max();
+}
+
+// An OutputSink that grows |output| itself, so the data is written in place
+// rather than copied out of temporary buffers. |output| is cleared, then its
+// capacity is reserved at |initial_size| bytes and doubles each time it is
+// full, up to |max_size| bytes. Each reservation is first tried with
+// base::UncheckedMalloc(), so that running out of memory fails the operation
+// rather than the process. Within the capacity, |output| is resized a piece at
+// a time, so the pages of the unused part are never touched.
+template <typename Container>
+class ContainerSink {
+ public:
+  ContainerSink(Container* output, size_t initial_size, size_t max_size)
+      : output_(output),
+        initial_size_(std::max<size_t>(initial_size, 1)),
+        max_size_(max_size),
+        sink_{&ContainerSink::Next, &ContainerSink::Finish, this} {
+    output_->clear();
+  }
+  ContainerSink(const ContainerSink&) = delete;
+  ContainerSink& operator=(const ContainerSink&) = delete;
+
+  zlib_internal::OutputSink* sink() { return &sink_; }
+
+ private:
+  static Bytef* Next(void* opaque, size_t* size) {
+    ContainerSink* self = static_cast<ContainerSink*>(opaque);
+    size_t total = self->output_->size();
+    if (total == self->reserved_) {
+      size_t grow = std::min(total ? total : self->initial_size_,
+                             self->max_size_ - total);
+      if (!grow || !self->Reserve(total + grow))
+        return nullptr;
+      self->reserved_ = total + grow;
+    }
+    size_t piece = std::min(self->reserved_ - total, kMaxPieceSize);
+    self->output_->resize(total + piece);
+    self->last_size_ = piece;
+    *size = piece;
+    return reinterpret_cast<Bytef*>(&(*self->output_)[total]);
+  }
+
+  static void Finish(void* opaque, size_t written) {
+    ContainerSink* self = static_cast<ContainerSink*>(opaque);
+    self->output_->resize(self->output_->size() - self->last_size_ + written);
+  }
+
+  // Reserves |capacity| elements once an allocation of that size has been
+  // seen to succeed, as the container would otherwise crash on failure.
+  bool Reserve(size_t capacity) {
+    if (capacity <= output_->capacity())
+      return true;
+    void* buffer;
+    if (!base::UncheckedMalloc(capacity, &buffer))
+      return false;
+    free(buffer);
+    output_->reserve(capacity);
+    return true;
+  }
+
+  // The largest buffer returned by Next().
+  static constexpr size_t kMaxPieceSize = 1024 * 1024;
+
+  Container* output_;
+  size_t initial_size_;
+  size_t max_size_;
+  size_t reserved_ = 0;   // The capacity reserved so far.
+  size_t last_size_ = 0;  // The size of the last buffer returned by Next().
+  zlib_internal::OutputSink sink_;
+};
+
+// Compresses |input| into |output|. The output starts at about a quarter of
+// the input size, and doubles whenever deflate() fills it, so no worst-case
+// sized temporary is needed.
+template <typename Container>
+bool GzipCompressToContainer(base::span<const uint8_t> input,
+                             Container* output,
+                             int max_threads = 1) {
+  if (!FitsInULong(input.size()))
+    return false;
+  ContainerSink<Container> sink(
+      output,
+      std::min<size_t>(zlib_internal::GzipExpectedCompressedSize(input.size()),
+                       input.size() / 4 + 64),
+      output->max_size());
+  return zlib_internal::ParallelCompressHelperToSink(
+             zlib_internal::GZIP, reinterpret_cast<const Bytef*>(input.data()),
+             static_cast<uLong>(input.size()), Z_DEFAULT_COMPRESSION,
+             max_threads, sink.sink(), nullptr, nullptr) == Z_OK;
+}
+
+// Uncompresses |input| into |output|, growing it from |initial_size| bytes, or
+// the input size if larger, as the data is decoded. For when the size in the
+// gzip trailer, which is only that of the last member, turns out too small.
+bool GzipUncompressGrowing(base::span<const uint8_t> input,
+                           size_t initial_size,
+                           std::string* output) {
+  if (!FitsInULong(input.size()))
+    return false;
+  ContainerSink<std::string> sink(output, std::max(initial_size, input.size()),
+                                 output->max_size());
+  size_t size = 0;
+  bool truncated = false;
+  return zlib_internal::UncompressHelperToSink(
+             zlib_internal::GZIP, reinterpret_cast<const Bytef*>(input.data()),
+             static_cast<uLong>(input.size()), output->max_size(), sink.sink(),
+             &size, &truncated) == Z_OK;
+}
+
+}  // namespace
+
 bool GzipCompress(base::span<const char> input,
                   char* output_buffer,
                   size_t output_buffer_size,
@@ -37,38 +159,33 @@ bool GzipCompress(base::span<const char> input, std::string* output) {
 }
 
 bool GzipCompress(base::span<const uint8_t> input, std::string* output) {
-  // Not using std::vector<> because allocation failures are recoverable,
-  // which is hidden by std::vector<>.
-  static_assert(sizeof(Bytef) == 1, "");
-  const uLongf input_size = static_cast<uLongf>(input.size());
-
-  uLongf compressed_data_size =
-      zlib_internal::GzipExpectedCompressedSize(input_size);
-
-  Bytef* compressed_data;
-  if (!base::UncheckedMalloc(compressed_data_size,
-                             reinterpret_cast<void**>(&compressed_data))) {
+  // Compress into a new string so that |output| is left untouched on failure,
+  // and so that |input| may be the contents of |output|.
+  std::string compressed;
+  if (!GzipCompressToContainer(input, &compressed))
     return false;
-  }
+  output->swap(compressed);
+  DCHECK_EQ(static_cast<uint32_t>(input.size()),
+            GetUncompressedSize(*output));
+  return true;
+}
 
-  if (zlib_internal::GzipCompressHelper(
-          compressed_data, &compressed_data_size,
-          reinterpret_cast<const Bytef*>(input.data()), input_size, nullptr,
-          nullptr) != Z_OK) {
-    free(compressed_data);
+bool GzipCompress(base::span<const uint8_t> input,
+                  std::string* output,
+                  int max_threads) {
+  std::string compressed;
+  if (!GzipCompressToContainer(input, &compressed, max_threads))
     return false;
-  }
+  output->swap(compressed);
+  return true;
+}
 
-  Bytef* resized_data =
-      reinterpret_cast<Bytef*>(realloc(compressed_data, compressed_data_size));
-  if (!resized_data) {
-    free(compressed_data);
+bool GzipCompress(base::span<const uint8_t> input,
+                  std::vector<uint8_t>* output) {
+  std::vector<uint8_t> compressed;
+  if (!GzipCompressToContainer(input, &compressed))
     return false;
-  }
-  output->assign(resized_data, resized_data + compressed_data_size);
-  DCHECK_EQ(input_size, GetUncompressedSize(*output));
-
-  free(resized_data);
+  output->swap(compressed);
   return true;
 }
 
@@ -79,14 +196,24 @@ bool GzipUncompress(const std::string& input, std::string* output) {
     return false;
 
   uncompressed_output.resize(uncompressed_size);
-  if (zlib_internal::GzipUncompressHelper(
-          reinterpret_cast<Bytef*>(uncompressed_output.data()),
-          &uncompressed_size, reinterpret_cast<const Bytef*>(input.data()),
-          static_cast<uLongf>(input.length())) == Z_OK) {
-    output->swap(uncompressed_output);
-    return true;
+  int err = zlib_internal::GzipUncompressHelper(
+      reinterpret_cast<Bytef*>(uncompressed_output.data()), &uncompressed_size,
+      reinterpret_cast<const Bytef*>(input.data()),
+      static_cast<uLongf>(input.length()));
+  if (err == Z_BUF_ERROR) {
+    // Several members, or more than 4 GB: decode again, growing the output.
+    if (!GzipUncompressGrowing(base::as_bytes(base::span<const char>(input)),
+                               uncompressed_output.size() * 2,
+                               &uncompressed_output)) {
+      return false;
+    }
+  } else if (err == Z_OK) {
+    uncompressed_output.resize(uncompressed_size);
+  } else {
+    return false;
   }
-  return false;
+  output->swap(uncompressed_output);
+  return true;
 }
 
 bool GzipUncompress(base::span<const char> input,
@@ -96,13 +223,27 @@ bool GzipUncompress(base::span<const char> input,
 
 bool GzipUncompress(base::span<const uint8_t> input,
                     base::span<const uint8_t> output) {
-  uLongf uncompressed_size = GetUncompressedSize(input);
-  if (uncompressed_size > output.size())
+  size_t output_size;
+  return GzipUncompress(input, output, &output_size);
+}
+
+bool GzipUncompress(base::span<const uint8_t> input,
+                    base::span<const uint8_t> output,
+                    size_t* output_size) {
+  *output_size = 0;
+  // The trailer holds the size of the last member, so with several members
+  // the output may be larger than it, up to the size of |output|.
+  if (GetUncompressedSize(input) > output.size())
+    return false;
+  uLongf uncompressed_size = static_cast<uLongf>(output.size());
+  if (zlib_internal::GzipUncompressHelper(
+          reinterpret_cast<Bytef*>(const_cast<uint8_t*>(output.data())),
+          &uncompressed_size, reinterpret_cast<const Bytef*>(input.data()),
+          static_cast<uLongf>(input.size())) != Z_OK) {
     return false;
-  return zlib_internal::GzipUncompressHelper(
-             reinterpret_cast<Bytef*>(const_cast<uint8_t*>(output.data())),
-             &uncompressed_size, reinterpret_cast<const Bytef*>(input.data()),
-             static_cast<uLongf>(input.size())) == Z_OK;
+  }
+  *output_size = uncompressed_size;
+  return true;
 }
 
 bool GzipUncompress(base::span<const char> input, std::string* output) {
@@ -110,14 +251,255 @@ bool GzipUncompress(base::span<const char> input, std::string* output) {
 }
 
 bool GzipUncompress(base::span<const uint8_t> input, std::string* output) {
+  return GzipUncompress(input, output, 1);
+}
+
+bool GzipUncompress(base::span<const uint8_t> input,
+                    std::string* output,
+                    int max_threads) {
   // Disallow in-place usage, i.e., |input| using |*output| as underlying data.
   DCHECK_NE(reinterpret_cast<const char*>(input.data()), output->data());
   uLongf uncompressed_size = GetUncompressedSize(input);
+  int err = Z_BUF_ERROR;
+  // The parallel helper asks for more space once if the members need it.
+  for (int attempt = 0; attempt < 2 && err == Z_BUF_ERROR; ++attempt) {
+    if (attempt && uncompressed_size <= output->size())
+      break;
+    output->resize(uncompressed_size);
+    err = zlib_internal::ParallelUncompressHelper(
+        zlib_internal::GZIP, reinterpret_cast<Bytef*>(output->data()),
+        &uncompressed_size, reinterpret_cast<const Bytef*>(input.data()),
+        static_cast<uLongf>(input.size()), max_threads);
+  }
+  if (err == Z_BUF_ERROR) {
+    // The trailer size was too small: decode again, growing the output.
+    return GzipUncompressGrowing(input, output->size() * 2, output);
+  }
+  if (err != Z_OK)
+    return false;
   output->resize(uncompressed_size);
-  return zlib_internal::GzipUncompressHelper(
-             reinterpret_cast<Bytef*>(output->data()), &uncompressed_size,
-             reinterpret_cast<const Bytef*>(input.data()),
-             static_cast<uLongf>(input.size())) == Z_OK;
+  return true;
+}
+
+// The size of the GzipCompressor and GzipDecompressor output buffer.
+constexpr size_t kStreamBufferSize = 64 * 1024;
+
+// Input larger than uInt is handed to zlib in pieces.
+constexpr size_t kMaxStreamInput = static_cast<uInt>(-1);
+
+struct GzipCompressor::State {
+  z_stream stream = {};
+  gz_header header = {};
+  bool initialized = false;
+  bool finished = false;
+  uint8_t buffer[kStreamBufferSize];
+};
+
+GzipCompressor::GzipCompressor() : state_(std::make_unique<State>()) {
+  // Use the same settings as GzipCompress(), so the output is the same.
+  state_->initialized =
+      deflateInit2(&state_->stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                   MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+  if (state_->initialized)
+    deflateSetHeader(&state_->stream, &state_->header);
+}
+
+GzipCompressor::~GzipCompressor() {
+  if (state_->initialized)
+    deflateEnd(&state_->stream);
+}
+
+namespace {
+
+// Runs deflate() over the pending input with |flush|, emitting the output to
+// |sink| as each buffer fills.
+bool Deflate(z_stream* stream, uint8_t* buffer, int flush, GzipSink sink) {
+  int err;
+  do {
+    stream->next_out = buffer;
+    stream->avail_out = kStreamBufferSize;
+    err = deflate(stream, flush);
+    if (err == Z_STREAM_ERROR)
+      return false;
+    size_t have = kStreamBufferSize - stream->avail_out;
+    if (have && !sink(base::span<const uint8_t>(buffer, have)))
+      return false;
+  } while (stream->avail_out == 0 ||
+           (flush == Z_FINISH && err != Z_STREAM_END));
+  return true;
+}
+
+}  // namespace
+
+bool GzipCompressor::Write(base::span<const uint8_t> input, GzipSink sink) {
+  if (!state_->initialized || state_->finished)
+    return false;
+  z_stream* stream = &state_->stream;
+  while (!input.empty()) {
+    size_t piece = std::min(input.size(), kMaxStreamInput);
+    stream->next_in = const_cast<Bytef*>(input.data());
+    stream->avail_in = static_cast<uInt>(piece);
+    if (!Deflate(stream, state_->buffer, Z_NO_FLUSH, sink))
+      return false;
+    DCHECK_EQ(stream->avail_in, 0u);
+    input = input.subspan(piece);
+  }
+  return true;
+}
+
+bool GzipCompressor::Finish(GzipSink sink) {
+  if (!state_->initialized || state_->finished)
+    return false;
+  state_->finished = true;
+  state_->stream.avail_in = 0;
+  return Deflate(&state_->stream, state_->buffer, Z_FINISH, sink);
+}
+
+void GzipCompressor::Reset() {
+  if (state_->initialized) {
+    deflateReset(&state_->stream);
+    deflateSetHeader(&state_->stream, &state_->header);
+  }
+  state_->finished = false;
+}
+
+struct GzipDecompressor::State {
+  z_stream stream = {};
+  bool initialized = false;
+  bool failed = false;
+  // True at the end of a gzip member, before the next one starts.
+  bool member_end = false;
+  // True once data other than a gzip member followed the end of a member: it
+  // is ignored, with any later input, as UncompressHelper() does.
+  bool trailing = false;
+  // The first bytes after the end of a member, until there are enough to tell
+  // whether another member follows.
+  uint8_t magic[2];
+  size_t magic_size = 0;
+  uint8_t buffer[kStreamBufferSize];
+};
+
+GzipDecompressor::GzipDecompressor() : state_(std::make_unique<State>()) {
+  state_->initialized = inflateInit2(&state_->stream, MAX_WBITS + 16) == Z_OK;
+}
+
+GzipDecompressor::~GzipDecompressor() {
+  if (state_->initialized)
+    inflateEnd(&state_->stream);
+}
+
+bool GzipDecompressor::Write(base::span<const uint8_t> input, GzipSink sink) {
+  if (!state_->initialized || state_->failed)
+    return false;
+  z_stream* stream = &state_->stream;
+  state_->failed = true;  // Until proven otherwise.
+  while (!input.empty()) {
+    size_t piece = std::min(input.size(), kMaxStreamInput);
+    stream->next_in = const_cast<Bytef*>(input.data());
+    stream->avail_in = static_cast<uInt>(piece);
+    input = input.subspan(piece);
+    do {
+      if (state_->member_end) {
+        // More input after the end of a member starts the next member if it
+        // starts with the gzip magic, and is ignored otherwise.
+        if (stream->avail_in == 0)
+          break;
+        if (state_->trailing) {
+          stream->avail_in = 0;
+          break;
+        }
+        size_t take = std::min(sizeof(state_->magic) - state_->magic_size,
+                               size_t{stream->avail_in});
+        memcpy(state_->magic + state_->magic_size, stream->next_in, take);
+        state_->magic_size += take;
+        stream->next_in += take;
+        stream->avail_in -= static_cast<uInt>(take);
+        if (state_->magic_size < sizeof(state_->magic))
+          break;
+        if (!zlib_internal::GzipMemberFollows(zlib_internal::GZIP,
+                                              state_->magic,
+                                              state_->magic_size)) {
+          state_->trailing = true;
+          stream->avail_in = 0;
+          break;
+        }
+        // Hand inflate() the magic, then go on with the rest of the input.
+        Bytef* next_in = stream->next_in;
+        uInt avail_in = stream->avail_in;
+        inflateReset(stream);
+        stream->next_in = state_->magic;
+        stream->avail_in = static_cast<uInt>(state_->magic_size);
+        stream->next_out = state_->buffer;
+        stream->avail_out = kStreamBufferSize;
+        if (inflate(stream, Z_NO_FLUSH) != Z_OK)
+          return false;
+        stream->next_in = next_in;
+        stream->avail_in = avail_in;
+        state_->member_end = false;
+        state_->magic_size = 0;
+      }
+      stream->next_out = state_->buffer;
+      stream->avail_out = kStreamBufferSize;
+      int err = inflate(stream, Z_NO_FLUSH);
+      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+        return false;
+      size_t have = kStreamBufferSize - stream->avail_out;
+      if (have && !sink(base::span<const uint8_t>(state_->buffer, have)))
+        return false;
+      if (err == Z_STREAM_END)
+        state_->member_end = true;
+      else if (err == Z_BUF_ERROR)
+        break;  // Needs more input.
+    } while (stream->avail_in > 0 || stream->avail_out == 0);
+  }
+  state_->failed = false;
+  return true;
+}
+
+bool GzipDecompressor::Finish() {
+  return state_->initialized && !state_->failed && state_->member_end;
+}
+
+void GzipDecompressor::Reset() {
+  if (state_->initialized)
+    inflateReset(&state_->stream);
+  state_->failed = false;
+  state_->member_end = false;
+  state_->trailing = false;
+  state_->magic_size = 0;
+}
+
+bool GzipUncompressWithLimit(base::span<const uint8_t> input,
+                             size_t max_output_size,
+                             std::string* output,
+                             GzipUncompressResult* result) {
+  // Start small: at the size in the gzip trailer if that is plausible, else at
+  // a few times the input size. The trailer is only a hint, and the output
+  // doubles as needed, so hostile input costs memory only for real output.
+  size_t initial_size = std::max<size_t>(input.size() * 4, 4096);
+  uint32_t trailer_size = GetUncompressedSize(input);
+  if (trailer_size && trailer_size < initial_size)
+    initial_size = trailer_size;
+  initial_size = std::min(initial_size, max_output_size);
+
+  output->clear();
+  if (!FitsInULong(input.size()))
+    return false;
+  ContainerSink<std::string> sink(
+      output, initial_size,
+      std::min<size_t>(max_output_size, output->max_size()));
+  size_t size = 0;
+  bool truncated = false;
+  int err = zlib_internal::UncompressHelperToSink(
+      zlib_internal::GZIP, reinterpret_cast<const Bytef*>(input.data()),
+      static_cast<uLong>(input.size()), max_output_size, sink.sink(), &size,
+      &truncated);
+  if (result) {
+    result->size = size;
+    result->truncated = truncated;
+    result->limit_exceeded = err == Z_BUF_ERROR;
+  }
+  return err == Z_OK;
 }
 
 uint32_t GetUncompressedSize(base::span<const char> compressed_data) {
@@ -5,12 +5,79 @@
 #ifndef THIRD_PARTY_ZLIB_GOOGLE_COMPRESSION_UTILS_H_
 #define THIRD_PARTY_ZLIB_GOOGLE_COMPRESSION_UTILS_H_
 
+#include <stdint.h>
+
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "base/containers/span.h"
+#include "base/functional/function_ref.h"
 
 namespace compression {
 
+// Receives the output of GzipCompressor and GzipDecompressor, a piece at a
+// time. Returns false to abort the operation.
+using GzipSink = base::FunctionRef<bool(base::span<const uint8_t>)>;
+
+// Compresses data into a gzip stream incrementally, with bounded memory: the
+// output is emitted to the sink in pieces of at most 64 KB, whatever the size
+// of the input. The output of Write() calls followed by Finish() is the same
+// as GzipCompress() of all the input.
+class GzipCompressor {
+ public:
+  GzipCompressor();
+  GzipCompressor(const GzipCompressor&) = delete;
+  GzipCompressor& operator=(const GzipCompressor&) = delete;
+  ~GzipCompressor();
+
+  // Compresses |input|, emitting any output to |sink|.
+  // Returns true for success.
+  bool Write(base::span<const uint8_t> input, GzipSink sink);
+
+  // Ends the gzip stream, emitting the remaining output to |sink|. No more
+  // input is accepted until Reset().
+  // Returns true for success.
+  bool Finish(GzipSink sink);
+
+  // Starts a new gzip stream, reusing the internal z_stream.
+  void Reset();
+
+ private:
+  struct State;
+  std::unique_ptr<State> state_;
+};
+
+// Uncompresses a gzip stream incrementally, with bounded memory, taking input
+// in pieces of any size. Unlike GzipUncompress(), it does not rely on the
+// 32-bit uncompressed size in the gzip trailer, so it handles output larger
+// than 4 GB, and untrusted input. Concatenated gzip members (multi-member
+// gzip) are uncompressed one after the other. As with GzipUncompress(), data
+// after a member that does not start another, such as zero padding, is
+// ignored.
+class GzipDecompressor {
+ public:
+  GzipDecompressor();
+  GzipDecompressor(const GzipDecompressor&) = delete;
+  GzipDecompressor& operator=(const GzipDecompressor&) = delete;
+  ~GzipDecompressor();
+
+  // Uncompresses |input|, emitting any output to |sink|.
+  // Returns true for success.
+  bool Write(base::span<const uint8_t> input, GzipSink sink);
+
+  // Returns true if the input so far ended at the end of a gzip member, and
+  // was valid. Returns false for truncated or invalid input.
+  bool Finish();
+
+  // Starts a new gzip stream, reusing the internal z_stream.
+  void Reset();
+
+ private:
+  struct State;
+  std::unique_ptr<State> state_;
+};
+
 // Compresses the data in |input| using gzip, storing the result in
 // |output_buffer|, of size |output_buffer_size|. If the buffer is large enough
 // and compression succeeds, |compressed_size| points to the compressed data
@@ -27,21 +94,40 @@ bool GzipCompress(base::span<const char> input,
 
 // Compresses the data in |input| using gzip, storing the result in |output|.
 // |input| and |output| are allowed to point to the same string (in-place
-// operation).
+// operation). The data is compressed into buffers that grow as needed, rather
+// than into a worst-case sized one, and |output| is unchanged on failure.
+// Returns false, rather than crashing, if those buffers cannot be allocated.
 // Returns true for success.
 bool GzipCompress(base::span<const char> input, std::string* output);
 
 // Like the above method, but using uint8_t instead.
 bool GzipCompress(base::span<const uint8_t> input, std::string* output);
 
+// Like the above method, but inputs of 4 MB or more are split into 1 MB
+// chunks, which are compressed on up to |max_threads| threads at a time. The
+// output is a single ordinary gzip stream, a little larger than that of the
+// single-threaded GzipCompress().
+bool GzipCompress(base::span<const uint8_t> input,
+                  std::string* output,
+                  int max_threads);
+
+// Like the above method, but compressing into a vector. To compress into other
+// storage, such as a list of chunks, see zlib_internal::OutputSink.
+bool GzipCompress(base::span<const uint8_t> input,
+                  std::vector<uint8_t>* output);
+
 // Uncompresses the data in |input| using gzip, storing the result in |output|.
 // |input| and |output| are allowed to be the same string (in-place operation).
+// Concatenated gzip members, as written by `cat a.gz b.gz`, are uncompressed
+// one after the other.
 // Returns true for success.
 bool GzipUncompress(const std::string& input, std::string* output);
 
 // Like the above method, but uses base::span to avoid allocations if
 // needed. |output|'s size must be at least as large as the return value from
-// GetUncompressedSize.
+// GetUncompressedSize, which with concatenated members is the size of the
+// last one only. Use the overload below to learn how much of |output| was
+// written.
 // Returns true for success.
 bool GzipUncompress(base::span<const char> input,
                     base::span<const char> output);
@@ -50,6 +136,13 @@ bool GzipUncompress(base::span<const char> input,
 bool GzipUncompress(base::span<const uint8_t> input,
                     base::span<const uint8_t> output);
 
+// Like the above method, but also sets |*output_size| to the number of bytes
+// written to |output|, which is less than its size when |output| is larger
+// than needed.
+bool GzipUncompress(base::span<const uint8_t> input,
+                    base::span<const uint8_t> output,
+                    size_t* output_size);
+
 // Uncompresses the data in |input| using gzip, and writes the results to
 // |output|, which must NOT be the underlying string of |input|, and is resized
 // if necessary.
@@ -59,7 +152,38 @@ bool GzipUncompress(base::span<const char> input, std::string* output);
 // Like the above method, but using uint8_t instead.
 bool GzipUncompress(base::span<const uint8_t> input, std::string* output);
 
-// Returns the uncompressed size from GZIP-compressed |compressed_data|.
+// Like the above method, but inputs of 1 MB or more made of several gzip
+// members have their members uncompressed on up to |max_threads| threads.
+bool GzipUncompress(base::span<const uint8_t> input,
+                    std::string* output,
+                    int max_threads);
+
+// The outcome of GzipUncompressWithLimit().
+struct GzipUncompressResult {
+  // The number of bytes decoded, which are in the output.
+  size_t size = 0;
+  // The input ended before the end of the gzip stream.
+  bool truncated = false;
+  // The output would have been larger than the limit.
+  bool limit_exceeded = false;
+};
+
+// Uncompresses the data in |input| using gzip into |output|, for untrusted
+// input. The uncompressed size in the gzip trailer is not trusted: the output
+// buffers start small and double as needed, so memory follows the real output
+// size, and decoding stops if the output would exceed |max_output_size| bytes.
+// On failure |output| holds the data decoded so far. If |result| is not null,
+// it reports the decoded size, and whether the input was truncated or the
+// limit exceeded.
+// Returns true for success.
+bool GzipUncompressWithLimit(base::span<const uint8_t> input,
+                             size_t max_output_size,
+                             std::string* output,
+                             GzipUncompressResult* result = nullptr);
+
+// Returns the uncompressed size from GZIP-compressed |compressed_data|, as
+// recorded in its last 4 bytes, modulo 2^32. For concatenated members this is
+// the size of the last member only.
 uint32_t GetUncompressedSize(base::span<const char> compressed_data);
 
 // Like the above method, but using uint8_t instead.
@@ -11,6 +11,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "gzheader.h"
+
+#if defined(__unix__) || defined(__APPLE__) || defined(__Fuchsia__)
+#include <pthread.h>
+#define COMPRESSION_UTILS_PTHREADS
+#endif
+
 namespace zlib_internal {
 
 // The difference in bytes between a zlib header and a gzip header.
@@ -32,19 +39,54 @@ uLongf GzipExpectedCompressedSize(uLongf input_size) {
   return kGzipZlibHeaderDifferenceBytes + compressBound(input_size);
 }
 
+namespace {
+
+// The smallest gzip member: a 10 byte header, an empty fixed Huffman block
+// and an 8 byte trailer.
+const size_t kMinGzipMemberBytes = 20;
+
+// Whether |source| starts with a plausible gzip member header: the magic
+// number and deflate method, no reserved flags, and a known XFL and OS byte.
+// Compressed data rarely passes for this by accident, which makes it a good
+// guess at where a member starts, but only decoding can tell for sure.
+bool IsGzipMemberHeader(const Bytef* source, size_t length) {
+  gzhdr_info info;
+  if (length < GZHDR_FIXED_SIZE ||
+      gzhdr_parse(source, GZHDR_FIXED_SIZE, &info) == GZHDR_BAD) {
+    return false;
+  }
+  if (source[8] != 0 && source[8] != 2 && source[8] != 4)
+    return false;
+  return source[9] <= 13 || source[9] == 255;
+}
+
+// Returns the offset of the next likely gzip member header in |source| that
+// leaves room for a whole member starting at |start|, or |length| if none.
+size_t NextGzipMember(const Bytef* source, size_t length, size_t start) {
+  size_t offset = start + kMinGzipMemberBytes;
+  while (offset + kMinGzipMemberBytes <= length) {
+    const void* magic = memchr(source + offset, 0x1f,
+                               length - kMinGzipMemberBytes + 1 - offset);
+    if (!magic)
+      break;
+    offset = static_cast<const Bytef*>(magic) - source;
+    if (IsGzipMemberHeader(source + offset, length - offset))
+      return offset;
+    ++offset;
+  }
+  return length;
+}
+
+}  // namespace
+
 // The expected decompressed size is stored in the last
 // 4 bytes of |input| in LE. See https://tools.ietf.org/html/rfc1952#page-5
+// For concatenated members it is only the size of the last one, so callers
+// treat it as a hint, and grow the output if the data turns out larger.
 uint32_t GetGzipUncompressedSize(const Bytef* compressed_data, size_t length) {
-  uint32_t size;
-  if (length < sizeof(size))
+  if (length < sizeof(uint32_t))
     return 0;
-
-  memcpy(&size, &compressed_data[length - sizeof(size)], sizeof(size));
-#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
-  return size;
-#else
-  return __builtin_bswap32(size);
-#endif
+  return static_cast<uint32_t>(gzhdr_trailer_size(compressed_data + length));
 }
 
 // The number of window bits determines the type of wrapper to use - see
@@ -69,44 +111,29 @@ int GzipCompressHelper(Bytef* dest,
                         Z_DEFAULT_COMPRESSION, malloc_fn, free_fn);
 }
 
-// This code is taken almost verbatim from third_party/zlib/compress.c. The only
-// difference is deflateInit2() is called which allows different window bits to
-// be set. > 16 causes a gzip header to be emitted rather than a zlib header,
-// and negative causes no header to emitted.
-//
-// Compression level can be a number from 1-9, with 1 being the fastest, 9 being
-// the best compression. The default, which the GZIP helper uses, is 6.
-int CompressHelper(WrapperType wrapper_type,
-                   Bytef* dest,
-                   uLongf* dest_length,
-                   const Bytef* source,
-                   uLong source_length,
-                   int compression_level,
-                   void* (*malloc_fn)(size_t),
-                   void (*free_fn)(void*)) {
+namespace {
+
+// Cannot convert capturing lambdas to function pointers directly, hence the
+// structure, which must outlive the z_stream set up by InitDeflateStream().
+struct MallocFreeFunctions {
+  void* (*malloc_fn)(size_t);
+  void (*free_fn)(void*);
+};
+
+// Sets up |stream| for deflate with the |wrapper_type| header and trailer,
+// allocating through |malloc_free| if it has a malloc_fn. |gzip_header| is
+// used for the GZIP wrapper, and must outlive the stream.
+int InitDeflateStream(z_stream* stream,
+                      WrapperType wrapper_type,
+                      int compression_level,
+                      MallocFreeFunctions* malloc_free,
+                      gz_header* gzip_header) {
   if (compression_level < 0 || compression_level > 9) {
     compression_level = Z_DEFAULT_COMPRESSION;
   }
 
-  z_stream stream;
-
-  // FIXME(cavalcantii): z_const is not defined as 'const'.
-  stream.next_in = static_cast<z_const Bytef*>(const_cast<Bytef*>(source));
-  stream.avail_in = static_cast<uInt>(source_length);
-  stream.next_out = dest;
-  stream.avail_out = static_cast<uInt>(*dest_length);
-  if (static_cast<uLong>(stream.avail_out) != *dest_length)
-    return Z_BUF_ERROR;
-
-  // Cannot convert capturing lambdas to function pointers directly, hence the
-  // structure.
-  struct MallocFreeFunctions {
-    void* (*malloc_fn)(size_t);
-    void (*free_fn)(void*);
-  } malloc_free = {malloc_fn, free_fn};
-
-  if (malloc_fn) {
-    if (!free_fn)
+  if (malloc_free->malloc_fn) {
+    if (!malloc_free->free_fn)
       return Z_BUF_ERROR;
 
     auto zalloc = [](void* opaque, uInt items, uInt size) {
@@ -117,42 +144,592 @@ int CompressHelper(WrapperType wrapper_type,
       return reinterpret_cast<MallocFreeFunctions*>(opaque)->free_fn(address);
     };
 
-    stream.zalloc = static_cast<alloc_func>(zalloc);
-    stream.zfree = static_cast<free_func>(zfree);
-    stream.opaque = static_cast<voidpf>(&malloc_free);
+    stream->zalloc = static_cast<alloc_func>(zalloc);
+    stream->zfree = static_cast<free_func>(zfree);
+    stream->opaque = static_cast<voidpf>(malloc_free);
   } else {
-    stream.zalloc = static_cast<alloc_func>(0);
-    stream.zfree = static_cast<free_func>(0);
-    stream.opaque = static_cast<voidpf>(0);
+    stream->zalloc = static_cast<alloc_func>(0);
+    stream->zfree = static_cast<free_func>(0);
+    stream->opaque = static_cast<voidpf>(0);
   }
 
-  int err = deflateInit2(&stream, compression_level, Z_DEFLATED,
+  int err = deflateInit2(stream, compression_level, Z_DEFLATED,
                          ZlibStreamWrapperType(wrapper_type), kZlibMemoryLevel,
                          Z_DEFAULT_STRATEGY);
   if (err != Z_OK)
     return err;
 
-  // This has to exist outside of the if statement to prevent it going off the
-  // stack before deflate(), which will use this object.
-  gz_header gzip_header;
   if (wrapper_type == GZIP) {
-    memset(&gzip_header, 0, sizeof(gzip_header));
-    err = deflateSetHeader(&stream, &gzip_header);
+    memset(gzip_header, 0, sizeof(*gzip_header));
+    err = deflateSetHeader(stream, gzip_header);
+    if (err != Z_OK) {
+      deflateEnd(stream);
+      return err;
+    }
+  }
+  return Z_OK;
+}
+
+#if defined(COMPRESSION_UTILS_PTHREADS)
+// The per-thread stream cache enabled by SetStreamCacheEnabled(). The deflate
+// streams keep the allocator they were made with, so a stream is only reused
+// by calls passing the same malloc_fn and free_fn.
+const int kCachedDeflateStreams = 4;
+
+struct CachedDeflateStream {
+  z_stream stream;
+  MallocFreeFunctions malloc_free;
+  gz_header gzip_header;
+  WrapperType wrapper_type;
+  int compression_level;
+  bool initialized;
+  bool in_use;
+  unsigned last_used;
+};
+
+struct StreamCache {
+  CachedDeflateStream deflate[kCachedDeflateStreams];
+  unsigned clock;
+  z_stream inflate;
+  bool inflate_initialized;
+  bool inflate_in_use;
+};
+
+pthread_key_t stream_cache_key;
+pthread_once_t stream_cache_once = PTHREAD_ONCE_INIT;
+bool stream_cache_key_created = false;
+
+void DestroyStreamCache(void* arg) {
+  StreamCache* cache = static_cast<StreamCache*>(arg);
+  for (int i = 0; i < kCachedDeflateStreams; ++i) {
+    if (cache->deflate[i].initialized)
+      deflateEnd(&cache->deflate[i].stream);
+  }
+  if (cache->inflate_initialized)
+    inflateEnd(&cache->inflate);
+  free(cache);
+}
+
+void CreateStreamCacheKey() {
+  stream_cache_key_created =
+      pthread_key_create(&stream_cache_key, DestroyStreamCache) == 0;
+}
+
+StreamCache* GetStreamCache() {
+  pthread_once(&stream_cache_once, CreateStreamCacheKey);
+  if (!stream_cache_key_created)
+    return nullptr;
+  return static_cast<StreamCache*>(pthread_getspecific(stream_cache_key));
+}
+#endif  // defined(COMPRESSION_UTILS_PTHREADS)
+
+}  // namespace
+
+void SetStreamCacheEnabled(bool enabled) {
+#if defined(COMPRESSION_UTILS_PTHREADS)
+  StreamCache* cache = GetStreamCache();
+  if (enabled && !cache && stream_cache_key_created) {
+    cache = static_cast<StreamCache*>(calloc(1, sizeof(StreamCache)));
+    if (cache && pthread_setspecific(stream_cache_key, cache) != 0)
+      free(cache);
+  } else if (!enabled && cache) {
+    pthread_setspecific(stream_cache_key, nullptr);
+    DestroyStreamCache(cache);
+  }
+#endif
+}
+
+namespace {
+
+// Points |*stream| at a deflate stream set up as by InitDeflateStream(). With
+// the stream cache enabled, that is a cached stream for the same wrapper type,
+// level and allocator if there is one, else a new one that replaces the least
+// recently used. Otherwise |*stream| itself is initialized, and |malloc_free|
+// and |gzip_header| must outlive it. Release it with ReleaseDeflateStream().
+int AcquireDeflateStream(z_stream** stream,
+                         WrapperType wrapper_type,
+                         int compression_level,
+                         MallocFreeFunctions* malloc_free,
+                         gz_header* gzip_header) {
+#if defined(COMPRESSION_UTILS_PTHREADS)
+  StreamCache* cache = GetStreamCache();
+  if (cache && (!malloc_free->malloc_fn || malloc_free->free_fn)) {
+    if (compression_level < 0 || compression_level > 9)
+      compression_level = 6;  // What Z_DEFAULT_COMPRESSION means.
+
+    CachedDeflateStream* entry = nullptr;
+    for (int i = 0; i < kCachedDeflateStreams && !entry; ++i) {
+      CachedDeflateStream* candidate = &cache->deflate[i];
+      if (candidate->initialized && !candidate->in_use &&
+          candidate->wrapper_type == wrapper_type &&
+          candidate->compression_level == compression_level &&
+          candidate->malloc_free.malloc_fn == malloc_free->malloc_fn &&
+          candidate->malloc_free.free_fn == malloc_free->free_fn) {
+        entry = candidate;
+      }
+    }
+    if (!entry) {
+      for (int i = 0; i < kCachedDeflateStreams; ++i) {
+        CachedDeflateStream* candidate = &cache->deflate[i];
+        if (candidate->in_use)
+          continue;
+        if (!entry || !candidate->initialized ||
+            (entry->initialized && candidate->last_used < entry->last_used)) {
+          entry = candidate;
+        }
+      }
+      if (entry) {
+        if (entry->initialized)
+          deflateEnd(&entry->stream);
+        entry->initialized = false;
+        entry->malloc_free = *malloc_free;
+        int err = InitDeflateStream(&entry->stream, wrapper_type,
+                                    compression_level, &entry->malloc_free,
+                                    &entry->gzip_header);
+        if (err != Z_OK)
+          return err;
+        entry->initialized = true;
+        entry->wrapper_type = wrapper_type;
+        entry->compression_level = compression_level;
+      }
+    }
+    // With every stream in use, as when a sink callback compresses too, fall
+    // through to a stream of its own.
+    if (entry) {
+      entry->in_use = true;
+      entry->last_used = ++cache->clock;
+      *stream = &entry->stream;
+      return Z_OK;
+    }
+  }
+#endif
+  return InitDeflateStream(*stream, wrapper_type, compression_level,
+                           malloc_free, gzip_header);
+}
+
+// Ends a stream from AcquireDeflateStream(), returning the deflateEnd()
+// result, or resets it for the next call if it is cached.
+int ReleaseDeflateStream(z_stream* stream) {
+#if defined(COMPRESSION_UTILS_PTHREADS)
+  StreamCache* cache = GetStreamCache();
+  for (int i = 0; cache && i < kCachedDeflateStreams; ++i) {
+    CachedDeflateStream* entry = &cache->deflate[i];
+    if (stream != &entry->stream)
+      continue;
+    entry->in_use = false;
+    if (deflateReset(stream) != Z_OK) {
+      deflateEnd(stream);
+      entry->initialized = false;
+    }
+    return Z_OK;
+  }
+#endif
+  return deflateEnd(stream);
+}
+
+// Like AcquireDeflateStream(), for inflate. The cache holds one inflate stream
+// per thread, which inflateReset2() switches between wrapper types.
+int AcquireInflateStream(z_stream** stream, WrapperType wrapper_type) {
+#if defined(COMPRESSION_UTILS_PTHREADS)
+  StreamCache* cache = GetStreamCache();
+  if (cache && !cache->inflate_in_use) {
+    int err;
+    if (cache->inflate_initialized) {
+      err = inflateReset2(&cache->inflate,
+                          ZlibStreamWrapperType(wrapper_type));
+    } else {
+      memset(&cache->inflate, 0, sizeof(cache->inflate));
+      err = inflateInit2(&cache->inflate,
+                         ZlibStreamWrapperType(wrapper_type));
+      cache->inflate_initialized = err == Z_OK;
+    }
     if (err != Z_OK)
       return err;
+    cache->inflate_in_use = true;
+    *stream = &cache->inflate;
+    return Z_OK;
+  }
+#endif
+  memset(*stream, 0, sizeof(**stream));
+  return inflateInit2(*stream, ZlibStreamWrapperType(wrapper_type));
+}
+
+// Ends a stream from AcquireInflateStream(), or keeps it for the next call if
+// it is cached.
+int ReleaseInflateStream(z_stream* stream) {
+#if defined(COMPRESSION_UTILS_PTHREADS)
+  StreamCache* cache = GetStreamCache();
+  if (cache && stream == &cache->inflate) {
+    cache->inflate_in_use = false;
+    return Z_OK;
   }
+#endif
+  return inflateEnd(stream);
+}
 
-  err = deflate(&stream, Z_FINISH);
+}  // namespace
+
+// This code is taken almost verbatim from third_party/zlib/compress.c. The only
+// difference is deflateInit2() is called which allows different window bits to
+// be set. > 16 causes a gzip header to be emitted rather than a zlib header,
+// and negative causes no header to emitted.
+//
+// Compression level can be a number from 1-9, with 1 being the fastest, 9 being
+// the best compression. The default, which the GZIP helper uses, is 6.
+int CompressHelper(WrapperType wrapper_type,
+                   Bytef* dest,
+                   uLongf* dest_length,
+                   const Bytef* source,
+                   uLong source_length,
+                   int compression_level,
+                   void* (*malloc_fn)(size_t),
+                   void (*free_fn)(void*)) {
+  if (static_cast<uLong>(static_cast<uInt>(*dest_length)) != *dest_length)
+    return Z_BUF_ERROR;
+
+  z_stream local_stream;
+  z_stream* stream = &local_stream;
+  MallocFreeFunctions malloc_free = {malloc_fn, free_fn};
+  // This has to exist outside of InitDeflateStream() to prevent it going off
+  // the stack before deflate(), which will use this object.
+  gz_header gzip_header;
+  int err = AcquireDeflateStream(&stream, wrapper_type, compression_level,
+                                 &malloc_free, &gzip_header);
+  if (err != Z_OK)
+    return err;
+
+  // FIXME(cavalcantii): z_const is not defined as 'const'.
+  stream->next_in = static_cast<z_const Bytef*>(const_cast<Bytef*>(source));
+  stream->avail_in = static_cast<uInt>(source_length);
+  stream->next_out = dest;
+  stream->avail_out = static_cast<uInt>(*dest_length);
+
+  err = deflate(stream, Z_FINISH);
   if (err != Z_STREAM_END) {
-    deflateEnd(&stream);
+    ReleaseDeflateStream(stream);
     return err == Z_OK ? Z_BUF_ERROR : err;
   }
-  *dest_length = stream.total_out;
+  *dest_length = stream->total_out;
 
-  err = deflateEnd(&stream);
+  err = ReleaseDeflateStream(stream);
   return err;
 }
 
+int GzipCompressHelperToSink(const Bytef* source,
+                             uLong source_length,
+                             OutputSink* sink,
+                             void* (*malloc_fn)(size_t),
+                             void (*free_fn)(void*)) {
+  return CompressHelperToSink(GZIP, source, source_length,
+                              Z_DEFAULT_COMPRESSION, sink, malloc_fn, free_fn);
+}
+
+// Like CompressHelper(), but asks |sink| for more output space whenever
+// deflate() fills the current buffer, instead of failing with Z_BUF_ERROR.
+// The input is fed in uInt sized pieces, so |source_length| is not limited to
+// 4GB where uLong is 64 bits.
+int CompressHelperToSink(WrapperType wrapper_type,
+                         const Bytef* source,
+                         uLong source_length,
+                         int compression_level,
+                         OutputSink* sink,
+                         void* (*malloc_fn)(size_t),
+                         void (*free_fn)(void*)) {
+  z_stream local_stream;
+  z_stream* stream = &local_stream;
+  MallocFreeFunctions malloc_free = {malloc_fn, free_fn};
+  gz_header gzip_header;
+  int err = AcquireDeflateStream(&stream, wrapper_type, compression_level,
+                                 &malloc_free, &gzip_header);
+  if (err != Z_OK)
+    return err;
+  stream->next_in = static_cast<z_const Bytef*>(const_cast<Bytef*>(source));
+  stream->avail_in = 0;
+  stream->next_out = Z_NULL;
+  stream->avail_out = 0;
+
+  // Input and output are handed to deflate() in uInt sized pieces.
+  const uInt kMaxPiece = static_cast<uInt>(-1);
+  uLong in_left = source_length;
+  size_t buffer_size = 0;  // Size of the last buffer returned by the sink.
+  size_t out_left = 0;     // The part of it not yet handed to deflate().
+  do {
+    if (stream->avail_out == 0) {
+      if (out_left == 0) {
+        stream->next_out = sink->next(sink->opaque, &buffer_size);
+        if (!stream->next_out || !buffer_size) {
+          ReleaseDeflateStream(stream);
+          return Z_MEM_ERROR;
+        }
+        out_left = buffer_size;
+      }
+      stream->avail_out =
+          out_left > kMaxPiece ? kMaxPiece : static_cast<uInt>(out_left);
+      out_left -= stream->avail_out;
+    }
+    if (stream->avail_in == 0) {
+      stream->avail_in =
+          in_left > kMaxPiece ? kMaxPiece : static_cast<uInt>(in_left);
+      in_left -= stream->avail_in;
+    }
+    err = deflate(stream, in_left ? Z_NO_FLUSH : Z_FINISH);
+  } while (err == Z_OK || (err == Z_BUF_ERROR && stream->avail_out == 0));
+
+  if (err != Z_STREAM_END) {
+    ReleaseDeflateStream(stream);
+    return err;
+  }
+  sink->finish(sink->opaque, buffer_size - out_left - stream->avail_out);
+  return ReleaseDeflateStream(stream);
+}
+
+namespace {
+
+// One chunk of a parallel compression: |length| bytes at |input| compressed
+// as raw deflate, primed with the 32K of input before it, and ended with a
+// sync flush (or the final block, for the last chunk) so that the chunks can
+// be concatenated.
+struct CompressChunk {
+  WrapperType wrapper_type;
+  int compression_level;
+  MallocFreeFunctions* malloc_free;
+  const Bytef* input;
+  size_t length;
+  size_t dictionary_length;
+  bool last;
+  Bytef* output;
+  size_t output_length;
+  uLong check;  // crc32 or adler32 of the input, for the trailer.
+  int err;
+};
+
+void* CompressChunkThread(void* arg) {
+  CompressChunk* chunk = static_cast<CompressChunk*>(arg);
+  z_stream stream;
+  gz_header unused;
+  chunk->err = InitDeflateStream(&stream, ZRAW, chunk->compression_level,
+                                 chunk->malloc_free, &unused);
+  if (chunk->err != Z_OK)
+    return nullptr;
+  if (chunk->dictionary_length) {
+    chunk->err = deflateSetDictionary(
+        &stream, chunk->input - chunk->dictionary_length,
+        static_cast<uInt>(chunk->dictionary_length));
+  }
+  if (chunk->err == Z_OK) {
+    stream.next_in = static_cast<z_const Bytef*>(
+        const_cast<Bytef*>(chunk->input));
+    stream.avail_in = static_cast<uInt>(chunk->length);
+    stream.next_out = chunk->output;
+    stream.avail_out = static_cast<uInt>(chunk->output_length);
+    chunk->err = deflate(&stream, chunk->last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (chunk->err == (chunk->last ? Z_STREAM_END : Z_OK) &&
+        stream.avail_in == 0 && stream.avail_out != 0) {
+      chunk->output_length = stream.total_out;
+      chunk->err = Z_OK;
+    } else if (chunk->err == Z_OK || chunk->err == Z_STREAM_END) {
+      chunk->err = Z_BUF_ERROR;
+    }
+  }
+  deflateEnd(&stream);
+
+  if (chunk->wrapper_type == GZIP)
+    chunk->check = crc32_z(0, chunk->input, chunk->length);
+  else if (chunk->wrapper_type == ZLIB)
+    chunk->check = adler32_z(1, chunk->input, chunk->length);
+  return nullptr;
+}
+
+// Copies bytes into the buffers handed out by an OutputSink.
+struct SinkWriter {
+  OutputSink* sink;
+  Bytef* next;
+  size_t left;
+  size_t size;
+
+  bool Write(const Bytef* data, size_t length) {
+    while (length) {
+      if (!left) {
+        next = sink->next(sink->opaque, &size);
+        if (!next || !size)
+          return false;
+        left = size;
+      }
+      size_t copy = length < left ? length : left;
+      memcpy(next, data, copy);
+      next += copy;
+      left -= copy;
+      data += copy;
+      length -= copy;
+    }
+    return true;
+  }
+
+  bool WriteByte(int byte) {
+    Bytef value = static_cast<Bytef>(byte);
+    return Write(&value, 1);
+  }
+};
+
+}  // namespace
+
+// Compresses inputs of kParallelCompressThreshold bytes or more in chunks of
+// kParallelCompressChunkSize, on up to |max_threads| threads at a time, in the
+// manner of pigz: each chunk is a raw deflate stream that uses the end of the
+// previous chunk as its dictionary, and all but the last chunk end on a byte
+// boundary with a sync flush. The chunks are concatenated between a single
+// header and trailer, the trailer check value being combined from the chunk
+// check values, so the result is one ordinary gzip, zlib or raw stream.
+//
+// The output is not the same as that of CompressHelperToSink(): it carries a
+// few more bytes per chunk. Smaller inputs, and |max_threads| <= 1, use
+// CompressHelperToSink(). Without pthreads, the chunks are compressed one at a
+// time.
+int ParallelCompressHelperToSink(WrapperType wrapper_type,
+                                 const Bytef* source,
+                                 uLong source_length,
+                                 int compression_level,
+                                 int max_threads,
+                                 OutputSink* sink,
+                                 void* (*malloc_fn)(size_t),
+                                 void (*free_fn)(void*)) {
+  if (max_threads <= 1 || source_length < kParallelCompressThreshold) {
+    return CompressHelperToSink(wrapper_type, source, source_length,
+                                compression_level, sink, malloc_fn, free_fn);
+  }
+  if (compression_level < 0 || compression_level > 9)
+    compression_level = 6;  // Z_DEFAULT_COMPRESSION, for the headers below.
+  if (malloc_fn && !free_fn)
+    return Z_BUF_ERROR;
+  MallocFreeFunctions malloc_free = {malloc_fn, free_fn};
+  void* (*allocate)(size_t) = malloc_fn ? malloc_fn : malloc;
+  void (*release)(void*) = malloc_fn ? free_fn : free;
+
+  // Each chunk is compressed into its own buffer, sized for the worst case:
+  // deflate's stored block overhead plus the sync flush marker.
+  const size_t chunk_bound = compressBound(kParallelCompressChunkSize) + 16;
+  const size_t chunks = (source_length + kParallelCompressChunkSize - 1) /
+                        kParallelCompressChunkSize;
+  const size_t kMaxThreads = 64;
+  size_t threads = static_cast<size_t>(max_threads);
+  if (threads > kMaxThreads)
+    threads = kMaxThreads;
+  if (threads > chunks)
+    threads = chunks;
+  Bytef* buffers = static_cast<Bytef*>(allocate(threads * chunk_bound));
+  CompressChunk* wave = static_cast<CompressChunk*>(
+      allocate(threads * sizeof(CompressChunk)));
+  if (!buffers || !wave) {
+    if (buffers)
+      release(buffers);
+    if (wave)
+      release(wave);
+    return Z_MEM_ERROR;
+  }
+
+  SinkWriter writer = {sink, nullptr, 0, 0};
+  int err = Z_OK;
+  if (wrapper_type == GZIP) {
+    // The header deflate() writes for the zeroed gz_header CompressHelper()
+    // sets: no name or time, OS code 0.
+    Bytef header[GZHDR_FIXED_SIZE];
+    gzhdr_write(header, gzhdr_xflags(compression_level, Z_DEFAULT_STRATEGY),
+                0);
+    if (!writer.Write(header, sizeof(header)))
+      err = Z_MEM_ERROR;
+  } else if (wrapper_type == ZLIB) {
+    int level_flags = compression_level < 2   ? 0
+                      : compression_level < 6 ? 1
+                      : compression_level == 6 ? 2
+                                               : 3;
+    unsigned header = ((Z_DEFLATED + ((MAX_WBITS - 8) << 4)) << 8) |
+                      (level_flags << 6);
+    header += 31 - (header % 31);
+    if (!writer.WriteByte(header >> 8) || !writer.WriteByte(header & 0xff))
+      err = Z_MEM_ERROR;
+  }
+
+  uLong check = wrapper_type == GZIP ? crc32(0, Z_NULL, 0)
+                                     : adler32(0, Z_NULL, 0);
+  size_t offset = 0;
+  while (err == Z_OK && offset < source_length) {
+    size_t count = 0;
+    for (; count < threads && offset < source_length; ++count) {
+      size_t length = source_length - offset;
+      if (length > kParallelCompressChunkSize)
+        length = kParallelCompressChunkSize;
+      CompressChunk chunk = {
+          wrapper_type,
+          compression_level,
+          &malloc_free,
+          source + offset,
+          length,
+          offset < 32768 ? offset : 32768,
+          offset + length == source_length,
+          buffers + count * chunk_bound,
+          chunk_bound,
+          0,
+          Z_OK};
+      wave[count] = chunk;
+      offset += length;
+    }
+
+#if defined(COMPRESSION_UTILS_PTHREADS)
+    // Compress the first chunk of the wave on this thread.
+    pthread_t ids[kMaxThreads];
+    size_t started = 1;
+    for (; started < count; ++started) {
+      if (pthread_create(&ids[started], nullptr, CompressChunkThread,
+                         &wave[started]) != 0) {
+        break;
+      }
+    }
+    CompressChunkThread(&wave[0]);
+    for (size_t i = 1; i < started; ++i)
+      pthread_join(ids[i], nullptr);
+    for (size_t i = started; i < count; ++i)
+      CompressChunkThread(&wave[i]);
+#else
+    for (size_t i = 0; i < count; ++i)
+      CompressChunkThread(&wave[i]);
+#endif
+
+    for (size_t i = 0; i < count && err == Z_OK; ++i) {
+      err = wave[i].err;
+      if (err == Z_OK &&
+          !writer.Write(wave[i].output, wave[i].output_length)) {
+        err = Z_MEM_ERROR;
+      }
+      if (wrapper_type == GZIP) {
+        check = crc32_combine(check, wave[i].check,
+                              static_cast<z_off_t>(wave[i].length));
+      } else if (wrapper_type == ZLIB) {
+        check = adler32_combine(check, wave[i].check,
+                                static_cast<z_off_t>(wave[i].length));
+      }
+    }
+  }
+  release(buffers);
+  release(wave);
+
+  if (err == Z_OK && wrapper_type == GZIP) {
+    Bytef trailer[GZHDR_TRAILER_SIZE];
+    gzhdr_write_trailer(trailer, check, source_length);
+    if (!writer.Write(trailer, sizeof(trailer)))
+      err = Z_MEM_ERROR;
+  } else if (err == Z_OK && wrapper_type == ZLIB) {
+    Bytef trailer[4];
+    for (int i = 0; i < 4; ++i)
+      trailer[i] = static_cast<Bytef>(check >> (8 * (3 - i)));
+    if (!writer.Write(trailer, sizeof(trailer)))
+      err = Z_MEM_ERROR;
+  }
+  if (err != Z_OK)
+    return err;
+  sink->finish(sink->opaque, writer.size - writer.left);
+  return Z_OK;
+}
+
 int GzipUncompressHelper(Bytef* dest,
                          uLongf* dest_length,
                          const Bytef* source,
@@ -160,46 +737,571 @@ int GzipUncompressHelper(Bytef* dest,
   return UncompressHelper(GZIP, dest, dest_length, source, source_length);
 }
 
+bool GzipMemberFollows(WrapperType wrapper_type,
+                       const Bytef* next,
+                       size_t left) {
+  return wrapper_type == GZIP && left >= 2 && next[0] == 0x1f &&
+         next[1] == 0x8b;
+}
+
 // This code is taken almost verbatim from third_party/zlib/uncompr.c. The only
 // difference is inflateInit2() is called which allows different window bits to
 // be set. > 16 causes a gzip header to be emitted rather than a zlib header,
-// and negative causes no header to emitted.
+// and negative causes no header to emitted. Concatenated gzip members are
+// decoded one after the other.
 int UncompressHelper(WrapperType wrapper_type,
                      Bytef* dest,
                      uLongf* dest_length,
                      const Bytef* source,
                      uLong source_length) {
-  z_stream stream;
-
-  // FIXME(cavalcantii): z_const is not defined as 'const'.
-  stream.next_in = static_cast<z_const Bytef*>(const_cast<Bytef*>(source));
-  stream.avail_in = static_cast<uInt>(source_length);
-  if (static_cast<uLong>(stream.avail_in) != source_length)
+  if (static_cast<uLong>(static_cast<uInt>(source_length)) != source_length)
     return Z_BUF_ERROR;
-
-  stream.next_out = dest;
-  stream.avail_out = static_cast<uInt>(*dest_length);
-  if (static_cast<uLong>(stream.avail_out) != *dest_length)
+  if (static_cast<uLong>(static_cast<uInt>(*dest_length)) != *dest_length)
     return Z_BUF_ERROR;
 
-  stream.zalloc = static_cast<alloc_func>(0);
-  stream.zfree = static_cast<free_func>(0);
-
-  int err = inflateInit2(&stream, ZlibStreamWrapperType(wrapper_type));
+  z_stream local_stream;
+  z_stream* stream = &local_stream;
+  int err = AcquireInflateStream(&stream, wrapper_type);
   if (err != Z_OK)
     return err;
 
-  err = inflate(&stream, Z_FINISH);
+  // FIXME(cavalcantii): z_const is not defined as 'const'.
+  stream->next_in = static_cast<z_const Bytef*>(const_cast<Bytef*>(source));
+  stream->avail_in = static_cast<uInt>(source_length);
+  stream->next_out = dest;
+  stream->avail_out = static_cast<uInt>(*dest_length);
+
+  err = inflate(stream, Z_FINISH);
+  while (err == Z_STREAM_END && GzipMemberFollows(wrapper_type, stream->next_in,
+                                                  stream->avail_in)) {
+    // inflateReset() clears total_out, which is recovered from avail_out.
+    err = inflateReset(stream);
+    if (err == Z_OK)
+      err = inflate(stream, Z_FINISH);
+  }
   if (err != Z_STREAM_END) {
-    inflateEnd(&stream);
-    if (err == Z_NEED_DICT || (err == Z_BUF_ERROR && stream.avail_in == 0))
+    ReleaseInflateStream(stream);
+    if (err == Z_NEED_DICT || (err == Z_BUF_ERROR && stream->avail_in == 0))
       return Z_DATA_ERROR;
     return err;
   }
-  *dest_length = stream.total_out;
+  *dest_length -= stream->avail_out;
 
-  err = inflateEnd(&stream);
+  err = ReleaseInflateStream(stream);
   return err;
 }
 
+namespace {
+
+// Deflate codes at most 258 bytes in a match of at least two bits, so no
+// member can expand by more than this.
+const size_t kMaxDeflateRatio = 1032;
+
+// One gzip member of a parallel decompression, and where its output goes.
+struct GzipMember {
+  size_t in_offset;
+  size_t in_length;
+  size_t out_offset;
+  size_t out_length;
+};
+
+// A run of consecutive members decoded on one thread.
+struct UncompressRange {
+  const Bytef* source;
+  Bytef* dest;
+  const GzipMember* members;
+  size_t count;
+  int err;
+};
+
+// Decodes each member of |arg| into exactly the space its trailer claims. Any
+// member that does not decode to the end of its input, or to a different
+// size, fails the range, since its boundaries were only a guess.
+void* UncompressRangeThread(void* arg) {
+  UncompressRange* range = static_cast<UncompressRange*>(arg);
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  range->err = inflateInit2(&stream, ZlibStreamWrapperType(GZIP));
+  for (size_t i = 0; i < range->count && range->err == Z_OK; ++i) {
+    const GzipMember& member = range->members[i];
+    if (i)
+      inflateReset(&stream);
+    stream.next_in = static_cast<z_const Bytef*>(
+        const_cast<Bytef*>(range->source + member.in_offset));
+    stream.avail_in = static_cast<uInt>(member.in_length);
+    stream.next_out = range->dest + member.out_offset;
+    stream.avail_out = static_cast<uInt>(member.out_length);
+    int err = inflate(&stream, Z_FINISH);
+    if (err != Z_STREAM_END || stream.avail_in || stream.avail_out)
+      range->err = Z_DATA_ERROR;
+  }
+  inflateEnd(&stream);
+  return nullptr;
+}
+
+}  // namespace
+
+// Decodes concatenated gzip members, as written by `cat` or by parallel
+// writers, on up to |max_threads| threads. The members are found by scanning
+// for member headers, and each is decoded into its own slot of |dest|, at the
+// offset given by the sizes in the trailers before it. The boundaries and
+// sizes are checked as the members are decoded: if any turn out wrong, say a
+// header pattern inside compressed data, or trailing garbage, the input is
+// decoded again by UncompressHelper(), whose result is the authority.
+//
+// If the trailer sizes add up to more than |*dest_length|, and to no more
+// than deflate could expand the members to, |*dest_length| is set to their
+// total and Z_BUF_ERROR returned, so the caller can retry with enough space.
+//
+// Inputs that are not GZIP, are under kParallelUncompressThreshold bytes or
+// hold a single member, and |max_threads| <= 1, use UncompressHelper().
+// Without pthreads, the members are decoded on this thread.
+int ParallelUncompressHelper(WrapperType wrapper_type,
+                             Bytef* dest,
+                             uLongf* dest_length,
+                             const Bytef* source,
+                             uLong source_length,
+                             int max_threads) {
+  if (wrapper_type != GZIP || max_threads <= 1 ||
+      source_length < kParallelUncompressThreshold ||
+      !IsGzipMemberHeader(source, source_length)) {
+    return UncompressHelper(wrapper_type, dest, dest_length, source,
+                            source_length);
+  }
+
+  size_t count = 0;
+  for (size_t start = 0; start < source_length; ++count)
+    start = NextGzipMember(source, source_length, start);
+  if (count < 2) {
+    return UncompressHelper(wrapper_type, dest, dest_length, source,
+                            source_length);
+  }
+  GzipMember* members =
+      static_cast<GzipMember*>(malloc(count * sizeof(GzipMember)));
+  if (!members) {
+    return UncompressHelper(wrapper_type, dest, dest_length, source,
+                            source_length);
+  }
+
+  // Lay out the members, giving up on any that inflate() cannot take whole,
+  // or whose trailer size deflate could not have compressed to its length.
+  const uInt kMaxPiece = static_cast<uInt>(-1);
+  bool fits = true;
+  size_t start = 0;
+  size_t out_offset = 0;
+  for (size_t i = 0; i < count; ++i) {
+    size_t end = NextGzipMember(source, source_length, start);
+    GzipMember member = {start, end - start, out_offset,
+                         gzhdr_trailer_size(source + end)};
+    members[i] = member;
+    fits = fits && member.in_length <= kMaxPiece &&
+           member.out_length / kMaxDeflateRatio <= member.in_length &&
+           member.out_length <= static_cast<size_t>(-1) - out_offset;
+    if (fits)
+      out_offset += member.out_length;
+    start = end;
+  }
+  if (fits && out_offset > *dest_length) {
+    free(members);
+    *dest_length = out_offset;
+    return Z_BUF_ERROR;
+  }
+
+  // Give each thread a run of members of about the same compressed size.
+  const size_t kMaxThreads = 64;
+  size_t threads = static_cast<size_t>(max_threads);
+  if (threads > kMaxThreads)
+    threads = kMaxThreads;
+  if (threads > count)
+    threads = count;
+  const size_t range_length = source_length / threads + 1;
+  UncompressRange ranges[kMaxThreads];
+  size_t used = 0;
+  for (size_t i = 0; fits && i < count; ++i) {
+    size_t range = members[i].in_offset / range_length;
+    if (used == 0 || range >= used) {
+      UncompressRange next = {source, dest, &members[i], 0, Z_OK};
+      ranges[used++] = next;
+    }
+    ++ranges[used - 1].count;
+  }
+
+#if defined(COMPRESSION_UTILS_PTHREADS)
+  pthread_t ids[kMaxThreads];
+  size_t started = 1;
+  for (; started < used; ++started) {
+    if (pthread_create(&ids[started], nullptr, UncompressRangeThread,
+                       &ranges[started]) != 0) {
+      break;
+    }
+  }
+  if (used)
+    UncompressRangeThread(&ranges[0]);
+  for (size_t i = 1; i < started; ++i)
+    pthread_join(ids[i], nullptr);
+  for (size_t i = started; i < used; ++i)
+    UncompressRangeThread(&ranges[i]);
+#else
+  for (size_t i = 0; i < used; ++i)
+    UncompressRangeThread(&ranges[i]);
+#endif
+  free(members);
+
+  bool decoded = fits;
+  for (size_t i = 0; i < used; ++i)
+    decoded = decoded && ranges[i].err == Z_OK;
+  if (!decoded) {
+    return UncompressHelper(wrapper_type, dest, dest_length, source,
+                            source_length);
+  }
+  *dest_length = out_offset;
+  return Z_OK;
+}
+
+// Like UncompressHelper(), but asks |sink| for output space as it goes, so
+// memory follows the real output size rather than a size recorded in the
+// (untrusted) input. Decoding stops with Z_BUF_ERROR if the output would
+// exceed |max_output_size| bytes. Concatenated gzip members are decoded one
+// after the other. Returns Z_DATA_ERROR for invalid input, and for input that
+// ends before the end of the stream, which also sets |*truncated|. In all
+// cases |*uncompressed_size| is set to the number of bytes decoded, and |sink|
+// is finished with them.
+int UncompressHelperToSink(WrapperType wrapper_type,
+                           const Bytef* source,
+                           uLong source_length,
+                           size_t max_output_size,
+                           OutputSink* sink,
+                           size_t* uncompressed_size,
+                           bool* truncated) {
+  *uncompressed_size = 0;
+  *truncated = false;
+
+  z_stream local_stream;
+  z_stream* stream = &local_stream;
+  int err = AcquireInflateStream(&stream, wrapper_type);
+  if (err != Z_OK)
+    return err;
+  stream->next_in = static_cast<z_const Bytef*>(const_cast<Bytef*>(source));
+  stream->avail_in = 0;
+  stream->next_out = Z_NULL;
+  stream->avail_out = 0;
+
+  // Input and output are handed to inflate() in uInt sized pieces.
+  const uInt kMaxPiece = static_cast<uInt>(-1);
+  uLong in_left = source_length;
+  size_t handed_out = 0;   // Output space handed to inflate() so far.
+  size_t buffer_size = 0;  // Size of the last buffer returned by the sink.
+  size_t out_left = 0;     // The part of it not yet handed to inflate().
+  // At the limit, inflate() gets one more byte of scratch space: if it fills
+  // it, the output is larger than |max_output_size|.
+  Bytef probe;
+  bool probing = false;
+  bool limit_exceeded = false;
+  do {
+    if (stream->avail_in == 0 && in_left) {
+      stream->avail_in =
+          in_left > kMaxPiece ? kMaxPiece : static_cast<uInt>(in_left);
+      in_left -= stream->avail_in;
+    }
+    if (stream->avail_out == 0) {
+      if (probing)
+        break;
+      if (out_left == 0 && handed_out == max_output_size) {
+        probing = true;
+        stream->next_out = &probe;
+        stream->avail_out = 1;
+      } else {
+        if (out_left == 0) {
+          size_t size = 0;
+          Bytef* next = sink->next(sink->opaque, &size);
+          if (!next || !size) {
+            err = Z_MEM_ERROR;
+            break;
+          }
+          stream->next_out = next;
+          buffer_size = size;
+          if (buffer_size > max_output_size - handed_out)
+            buffer_size = max_output_size - handed_out;
+          out_left = buffer_size;
+          handed_out += buffer_size;
+        }
+        stream->avail_out =
+            out_left > kMaxPiece ? kMaxPiece : static_cast<uInt>(out_left);
+        out_left -= stream->avail_out;
+      }
+    }
+    err = inflate(stream, Z_NO_FLUSH);
+    if (err == Z_STREAM_END) {
+      size_t consumed = stream->next_in - source;
+      if (GzipMemberFollows(wrapper_type, stream->next_in,
+                            source_length - consumed)) {
+        err = inflateReset(stream);
+      }
+    }
+  } while (err == Z_OK || (err == Z_BUF_ERROR && stream->avail_out == 0));
+  if (probing && stream->avail_out == 0)
+    limit_exceeded = true;
+
+  size_t unused = out_left + (probing ? 0 : stream->avail_out);
+  *uncompressed_size = handed_out - unused;
+  sink->finish(sink->opaque, buffer_size - unused);
+  ReleaseInflateStream(stream);
+
+  if (limit_exceeded)
+    return Z_BUF_ERROR;
+  if (err == Z_STREAM_END)
+    return Z_OK;
+  if (err == Z_BUF_ERROR) {
+    *truncated = true;
+    return Z_DATA_ERROR;
+  }
+  return err == Z_NEED_DICT ? Z_DATA_ERROR : err;
+}
+
+#if defined(COMPRESSION_UTILS_PTHREADS)
+// The records queued by a GzRecordWriter sit in a ring buffer, each as an
+// 8-byte header followed by the data, padded to a multiple of 8 bytes. A
+// producer reserves its space by advancing |head| with a compare-and-swap,
+// copies the data in, then publishes the header. The compressor thread takes
+// the records in reservation order as they are published, writes each one
+// whole with gzfwrite(), zeroes its space and advances |tail| to free it. The
+// mutex is only taken when the ring is full, by producers waiting for space,
+// or empty, by the compressor waiting for a record.
+struct GzRecordWriter {
+  gzFile file;
+  unsigned char* ring;
+  uint64_t capacity;  // A power of two.
+  uint64_t head;      // Atomic: end of the reserved space.
+  uint64_t tail;      // Atomic: start of the first unwritten record.
+  int space_waiters;  // Atomic: producers waiting for space.
+  int compressor_waiting;  // Atomic.
+  int closing;             // Atomic.
+  int error;               // Atomic: the first gzfwrite() error, or Z_OK.
+  pthread_mutex_t mutex;
+  pthread_cond_t space;
+  pthread_cond_t data;
+  pthread_t thread;
+};
+
+namespace {
+
+const uint64_t kRecordHeaderBytes = 8;
+const uint64_t kRecordReady = 1;  // Header: size << 1 | kRecordReady.
+const size_t kMinRecordRingBytes = 64 * 1024;
+
+uint64_t RecordSpace(size_t size) {
+  return (kRecordHeaderBytes + size + 7) & ~uint64_t{7};
+}
+
+uint64_t* RecordHeader(GzRecordWriter* writer, uint64_t pos) {
+  return reinterpret_cast<uint64_t*>(writer->ring +
+                                     (pos & (writer->capacity - 1)));
+}
+
+// Waits until the ring has room up to |end|, or the writer has failed.
+void WaitForRecordSpace(GzRecordWriter* writer, uint64_t end) {
+  __atomic_add_fetch(&writer->space_waiters, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_lock(&writer->mutex);
+  while (end > __atomic_load_n(&writer->tail, __ATOMIC_SEQ_CST) +
+                   writer->capacity &&
+         __atomic_load_n(&writer->error, __ATOMIC_RELAXED) == Z_OK) {
+    pthread_cond_wait(&writer->space, &writer->mutex);
+  }
+  pthread_mutex_unlock(&writer->mutex);
+  __atomic_sub_fetch(&writer->space_waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+// Waits until the record at |tail| is published. Returns false instead if
+// the writer is closing and every record has been written.
+bool WaitForRecord(GzRecordWriter* writer, uint64_t tail) {
+  uint64_t* header = RecordHeader(writer, tail);
+  bool more = true;
+  pthread_mutex_lock(&writer->mutex);
+  __atomic_store_n(&writer->compressor_waiting, 1, __ATOMIC_SEQ_CST);
+  while (!(__atomic_load_n(header, __ATOMIC_SEQ_CST) & kRecordReady)) {
+    if (__atomic_load_n(&writer->closing, __ATOMIC_SEQ_CST) &&
+        __atomic_load_n(&writer->head, __ATOMIC_SEQ_CST) == tail) {
+      more = false;
+      break;
+    }
+    pthread_cond_wait(&writer->data, &writer->mutex);
+  }
+  __atomic_store_n(&writer->compressor_waiting, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&writer->mutex);
+  return more;
+}
+
+// Frees the ring up to |tail| for producers. The compressor does this after
+// every eighth of the ring, and before it waits for a record, rather than
+// after each record: producers waiting for space are woken less often, and
+// with more room.
+void FreeRecordSpace(GzRecordWriter* writer, uint64_t tail) {
+  if (tail == writer->tail)
+    return;
+  __atomic_store_n(&writer->tail, tail, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&writer->space_waiters, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&writer->mutex);
+    pthread_cond_broadcast(&writer->space);
+    pthread_mutex_unlock(&writer->mutex);
+  }
+}
+
+// The compressor thread. After a gzfwrite() error it keeps taking records, so
+// that no producer waits forever, but drops them.
+void* GzRecordWriterThread(void* arg) {
+  GzRecordWriter* writer = static_cast<GzRecordWriter*>(arg);
+  uint64_t tail = 0;
+  for (;;) {
+    uint64_t* header = RecordHeader(writer, tail);
+    uint64_t value = __atomic_load_n(header, __ATOMIC_ACQUIRE);
+    if (!(value & kRecordReady)) {
+      FreeRecordSpace(writer, tail);
+      if (!WaitForRecord(writer, tail))
+        break;
+      continue;
+    }
+
+    // Write the record, which may wrap around the end of the ring, then
+    // zero its space: stale data must not pass for a header later on.
+    size_t size = static_cast<size_t>(value >> 1);
+    uint64_t space = RecordSpace(size);
+    uint64_t start = (tail + kRecordHeaderBytes) & (writer->capacity - 1);
+    uint64_t first = writer->capacity - start;
+    if (first > size)
+      first = size;
+    if (__atomic_load_n(&writer->error, __ATOMIC_RELAXED) == Z_OK &&
+        size != 0 &&
+        (gzfwrite(writer->ring + start, 1, static_cast<z_size_t>(first),
+                  writer->file) == 0 ||
+         (size > first && gzfwrite(writer->ring, 1, size - first,
+                                   writer->file) == 0))) {
+      int err;
+      gzerror(writer->file, &err);
+      __atomic_store_n(&writer->error, err != Z_OK ? err : Z_ERRNO,
+                       __ATOMIC_SEQ_CST);
+    }
+    uint64_t offset = tail & (writer->capacity - 1);
+    first = writer->capacity - offset;
+    if (first > space)
+      first = space;
+    memset(writer->ring + offset, 0, static_cast<size_t>(first));
+    memset(writer->ring, 0, static_cast<size_t>(space - first));
+
+    tail += space;
+    if (tail - writer->tail >= writer->capacity / 8)
+      FreeRecordSpace(writer, tail);
+  }
+  return nullptr;
+}
+
+}  // namespace
+#endif  // defined(COMPRESSION_UTILS_PTHREADS)
+
+GzRecordWriter* GzRecordWriterOpen(gzFile file, size_t buffer_size) {
+#if defined(COMPRESSION_UTILS_PTHREADS)
+  if (!file)
+    return nullptr;
+  uint64_t capacity = kMinRecordRingBytes;
+  while (capacity < buffer_size && capacity <= SIZE_MAX / 2)
+    capacity <<= 1;
+
+  GzRecordWriter* writer =
+      static_cast<GzRecordWriter*>(calloc(1, sizeof(GzRecordWriter)));
+  if (!writer)
+    return nullptr;
+  writer->ring = static_cast<unsigned char*>(calloc(1, capacity));
+  if (!writer->ring) {
+    free(writer);
+    return nullptr;
+  }
+  writer->file = file;
+  writer->capacity = capacity;
+  writer->error = Z_OK;
+  pthread_mutex_init(&writer->mutex, nullptr);
+  pthread_cond_init(&writer->space, nullptr);
+  pthread_cond_init(&writer->data, nullptr);
+  if (pthread_create(&writer->thread, nullptr, GzRecordWriterThread, writer)) {
+    pthread_cond_destroy(&writer->data);
+    pthread_cond_destroy(&writer->space);
+    pthread_mutex_destroy(&writer->mutex);
+    free(writer->ring);
+    free(writer);
+    return nullptr;
+  }
+  return writer;
+#else
+  return nullptr;
+#endif
+}
+
+int GzRecordWriterAppend(GzRecordWriter* writer,
+                         const void* record,
+                         size_t size) {
+#if defined(COMPRESSION_UTILS_PTHREADS)
+  if (size > writer->capacity - kRecordHeaderBytes)
+    return Z_BUF_ERROR;
+  uint64_t space = RecordSpace(size);
+
+  // Reserve the space, waiting for the compressor to free some if need be.
+  uint64_t pos = __atomic_load_n(&writer->head, __ATOMIC_RELAXED);
+  for (;;) {
+    int err = __atomic_load_n(&writer->error, __ATOMIC_RELAXED);
+    if (err != Z_OK)
+      return err;
+    // |pos| may be stale, and behind |tail|, until the compare-and-swap.
+    if (pos + space >
+        __atomic_load_n(&writer->tail, __ATOMIC_ACQUIRE) + writer->capacity) {
+      WaitForRecordSpace(writer, pos + space);
+      pos = __atomic_load_n(&writer->head, __ATOMIC_RELAXED);
+      continue;
+    }
+    if (__atomic_compare_exchange_n(&writer->head, &pos, pos + space, true,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+
+  // Copy the record in, then publish it.
+  uint64_t start = (pos + kRecordHeaderBytes) & (writer->capacity - 1);
+  uint64_t first = writer->capacity - start;
+  if (first > size)
+    first = size;
+  memcpy(writer->ring + start, record, static_cast<size_t>(first));
+  memcpy(writer->ring, static_cast<const unsigned char*>(record) + first,
+         static_cast<size_t>(size - first));
+  __atomic_store_n(RecordHeader(writer, pos),
+                   static_cast<uint64_t>(size) << 1 | kRecordReady,
+                   __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&writer->compressor_waiting, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&writer->mutex);
+    pthread_cond_signal(&writer->data);
+    pthread_mutex_unlock(&writer->mutex);
+  }
+  return Z_OK;
+#else
+  return Z_STREAM_ERROR;
+#endif
+}
+
+int GzRecordWriterClose(GzRecordWriter* writer) {
+#if defined(COMPRESSION_UTILS_PTHREADS)
+  __atomic_store_n(&writer->closing, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_lock(&writer->mutex);
+  pthread_cond_signal(&writer->data);
+  pthread_mutex_unlock(&writer->mutex);
+  pthread_join(writer->thread, nullptr);
+
+  int err = writer->error;
+  int close_err = gzclose(writer->file);
+  pthread_cond_destroy(&writer->data);
+  pthread_cond_destroy(&writer->space);
+  pthread_mutex_destroy(&writer->mutex);
+  free(writer->ring);
+  free(writer);
+  return err != Z_OK ? err : close_err;
+#else
+  return Z_STREAM_ERROR;
+#endif
+}
+
 }  // namespace zlib_internal
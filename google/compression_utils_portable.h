@@ -7,6 +7,7 @@
 #ifndef THIRD_PARTY_ZLIB_GOOGLE_COMPRESSION_UTILS_PORTABLE_H_
 #define THIRD_PARTY_ZLIB_GOOGLE_COMPRESSION_UTILS_PORTABLE_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 /* TODO(cavalcantii): remove support for Chromium ever building with a system
@@ -31,6 +32,17 @@ uLongf GzipExpectedCompressedSize(uLongf input_size);
 
 uint32_t GetGzipUncompressedSize(const Bytef* compressed_data, size_t length);
 
+// Enables or disables, for the calling thread, the reuse of initialized
+// z_streams by CompressHelper(), UncompressHelper() and their *ToSink
+// variants. Each call otherwise sets up and tears down its own stream, which
+// at the default settings means some 270K of allocation and zeroing; with the
+// cache enabled, streams are reset and kept for the next call instead. The
+// cache holds up to four deflate streams, keyed by wrapper type, level and
+// malloc_fn/free_fn, and one inflate stream. Disabling it, or exiting the
+// thread, frees them. Must not be called from an OutputSink callback. Has no
+// effect on platforms without pthreads.
+void SetStreamCacheEnabled(bool enabled);
+
 int GzipCompressHelper(Bytef* dest,
                        uLongf* dest_length,
                        const Bytef* source,
@@ -47,6 +59,77 @@ int CompressHelper(WrapperType wrapper_type,
                    void* (*malloc_fn)(size_t),
                    void (*free_fn)(void*));
 
+// A growable destination for the *ToSink compression helpers, which compress
+// directly into storage owned by the caller (a string, a vector, a list of
+// chunks) rather than into a worst-case sized buffer.
+//
+// |next| is called whenever the current output buffer is full. It returns the
+// next buffer to write to and sets |*size| to its size (> 0), or returns
+// nullptr on allocation failure. |finish| is called once compression succeeds,
+// with the number of bytes written to the last buffer returned by |next|.
+// UncompressHelperToSink() also calls |finish| on failure, to keep the output
+// decoded up to that point.
+struct OutputSink {
+  Bytef* (*next)(void* opaque, size_t* size);
+  void (*finish)(void* opaque, size_t written);
+  void* opaque;
+};
+
+int GzipCompressHelperToSink(const Bytef* source,
+                             uLong source_length,
+                             OutputSink* sink,
+                             void* (*malloc_fn)(size_t),
+                             void (*free_fn)(void*));
+
+int CompressHelperToSink(WrapperType wrapper_type,
+                         const Bytef* source,
+                         uLong source_length,
+                         int compression_level,
+                         OutputSink* sink,
+                         void* (*malloc_fn)(size_t),
+                         void (*free_fn)(void*));
+
+// Inputs of at least this size are compressed in parallel by
+// ParallelCompressHelperToSink(), in chunks of kParallelCompressChunkSize.
+const size_t kParallelCompressThreshold = 4 * 1024 * 1024;
+const size_t kParallelCompressChunkSize = 1024 * 1024;
+
+int ParallelCompressHelperToSink(WrapperType wrapper_type,
+                                 const Bytef* source,
+                                 uLong source_length,
+                                 int compression_level,
+                                 int max_threads,
+                                 OutputSink* sink,
+                                 void* (*malloc_fn)(size_t),
+                                 void (*free_fn)(void*));
+
+// A gzip file writer that any number of threads may append records to at
+// once, without a lock of their own. Each record is written to the file
+// whole, never interleaved with another; records from one thread keep their
+// order. Appending copies the record into a ring buffer, which takes no lock
+// unless the buffer is full; a thread started by GzRecordWriterOpen() takes
+// the records off it and compresses them with gzfwrite().
+struct GzRecordWriter;
+
+// Starts a writer for |file|, opened for writing with gzopen() or gzdopen(),
+// which it takes over. Up to |buffer_size| bytes of records, rounded up to a
+// power of two of at least 64K, can wait to be compressed before appending
+// blocks. Returns nullptr, leaving |file| to the caller, on failure and on
+// platforms without pthreads.
+GzRecordWriter* GzRecordWriterOpen(gzFile file, size_t buffer_size);
+
+// Queues |size| bytes at |record| to be written as one record. Returns Z_OK,
+// Z_BUF_ERROR if the record cannot fit in the buffer, or the error the writer
+// failed with earlier, if any; records appended after a failure are dropped.
+int GzRecordWriterAppend(GzRecordWriter* writer,
+                         const void* record,
+                         size_t size);
+
+// Writes the queued records, stops the writer's thread, and closes the file
+// and the writer. Appends must have returned before this is called. Returns
+// the first error the writer failed with, else the result of gzclose().
+int GzRecordWriterClose(GzRecordWriter* writer);
+
 int GzipUncompressHelper(Bytef* dest,
                          uLongf* dest_length,
                          const Bytef* source,
@@ -58,6 +141,32 @@ int UncompressHelper(WrapperType wrapper_type,
                      const Bytef* source,
                      uLong source_length);
 
+// Whether a gzip member that ended at |next|, with |left| bytes of input after
+// it, is followed by another one, as in the output of `cat a.gz b.gz`. The
+// decoders ignore anything else after a member, such as zero padding.
+bool GzipMemberFollows(WrapperType wrapper_type,
+                       const Bytef* next,
+                       size_t left);
+
+// Gzip inputs of at least this size are decoded in parallel by
+// ParallelUncompressHelper(), when they hold more than one member.
+const size_t kParallelUncompressThreshold = 1024 * 1024;
+
+int ParallelUncompressHelper(WrapperType wrapper_type,
+                             Bytef* dest,
+                             uLongf* dest_length,
+                             const Bytef* source,
+                             uLong source_length,
+                             int max_threads);
+
+int UncompressHelperToSink(WrapperType wrapper_type,
+                           const Bytef* source,
+                           uLong source_length,
+                           size_t max_output_size,
+                           OutputSink* sink,
+                           size_t* uncompressed_size,
+                           bool* truncated);
+
 }  // namespace zlib_internal
 
 #endif  // THIRD_PARTY_ZLIB_GOOGLE_COMPRESSION_UTILS_PORTABLE_H_
@@ -6,9 +6,12 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
+#include <algorithm>
 #include <iterator>
 #include <string>
+#include <vector>
 
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -82,6 +85,133 @@ TEST(CompressionUtilsTest, LargeInput) {
   EXPECT_EQ(data, uncompressed_data);
 }
 
+TEST(CompressionUtilsTest, GzipCompressionToVector) {
+  std::vector<uint8_t> compressed_data;
+  EXPECT_TRUE(GzipCompress(kData, &compressed_data));
+  EXPECT_EQ(std::vector<uint8_t>(std::begin(kCompressedData),
+                                 std::end(kCompressedData)),
+            compressed_data);
+}
+
+// Checks that the output grows past its initial size for incompressible input.
+TEST(CompressionUtilsTest, IncompressibleInput) {
+  const size_t kSize = 256 * 1024;
+
+  std::string data(kSize, 0);
+  uint32_t state = 1;
+  for (size_t i = 0; i < kSize; ++i) {
+    state = state * 1103515245 + 12345;
+    data[i] = static_cast<char>(state >> 24);
+  }
+
+  std::string compressed_data;
+  EXPECT_TRUE(GzipCompress(data, &compressed_data));
+  EXPECT_GT(compressed_data.size(), kSize);
+
+  std::string uncompressed_data;
+  EXPECT_TRUE(GzipUncompress(compressed_data, &uncompressed_data));
+  EXPECT_EQ(data, uncompressed_data);
+}
+
+TEST(CompressionUtilsTest, ParallelCompression) {
+  const size_t kSize = 6 * 1024 * 1024 + 123;
+
+  std::string data(kSize, 0);
+  for (size_t i = 0; i < kSize; ++i)
+    data[i] = static_cast<char>((i * 7) % 251 + (i >> 16));
+
+  std::string compressed_data;
+  EXPECT_TRUE(GzipCompress(base::as_bytes(base::span<const char>(data)),
+                           &compressed_data, 4));
+  EXPECT_EQ(kSize, GetUncompressedSize(compressed_data));
+
+  std::string uncompressed_data;
+  EXPECT_TRUE(GzipUncompress(compressed_data, &uncompressed_data));
+  EXPECT_EQ(data, uncompressed_data);
+}
+
+TEST(CompressionUtilsTest, ConcatenatedMembers) {
+  // As `cat a.gz b.gz c.gz` would produce.
+  std::string data;
+  std::string compressed_data;
+  for (const char* text : {"first member, ", "second member, ", "third"}) {
+    std::string member;
+    EXPECT_TRUE(GzipCompress(base::span<const char>(text, strlen(text)),
+                             &member));
+    data += text;
+    compressed_data += member;
+  }
+  // Only the last member's size is at the end of the data.
+  EXPECT_EQ(strlen("third"), GetUncompressedSize(compressed_data));
+
+  std::string uncompressed_data;
+  EXPECT_TRUE(GzipUncompress(compressed_data, &uncompressed_data));
+  EXPECT_EQ(data, uncompressed_data);
+
+  uncompressed_data.clear();
+  EXPECT_TRUE(GzipUncompress(
+      base::as_bytes(base::span<const char>(compressed_data)),
+      &uncompressed_data, 4));
+  EXPECT_EQ(data, uncompressed_data);
+
+  std::string buffer(data.size(), '\0');
+  EXPECT_TRUE(GzipUncompress(base::span<const char>(compressed_data),
+                             base::span<const char>(buffer)));
+  EXPECT_EQ(data, buffer);
+
+  // An oversized output reports how much of it holds the members.
+  std::vector<uint8_t> large_buffer(data.size() + 100, 0xff);
+  size_t output_size = 0;
+  EXPECT_TRUE(GzipUncompress(
+      base::as_bytes(base::span<const char>(compressed_data)),
+      base::span<const uint8_t>(large_buffer), &output_size));
+  EXPECT_EQ(data.size(), output_size);
+  EXPECT_EQ(data, std::string(large_buffer.begin(),
+                              large_buffer.begin() + output_size));
+}
+
+TEST(CompressionUtilsTest, UncompressWithLimit) {
+  const size_t kSize = 100 * 1024;
+  std::string data(kSize, 'a');
+  std::string compressed_data;
+  EXPECT_TRUE(GzipCompress(data, &compressed_data));
+  base::span<const uint8_t> input =
+      base::as_bytes(base::span<const char>(compressed_data));
+
+  std::string output;
+  GzipUncompressResult result;
+  EXPECT_TRUE(GzipUncompressWithLimit(input, kSize, &output, &result));
+  EXPECT_EQ(data, output);
+  EXPECT_EQ(kSize, result.size);
+  EXPECT_FALSE(result.truncated);
+  EXPECT_FALSE(result.limit_exceeded);
+
+  // One byte over the limit.
+  EXPECT_FALSE(GzipUncompressWithLimit(input, kSize - 1, &output, &result));
+  EXPECT_TRUE(result.limit_exceeded);
+  EXPECT_EQ(kSize - 1, result.size);
+  EXPECT_EQ(kSize - 1, output.size());
+
+  // A lying trailer does not matter.
+  std::string lying_data = compressed_data;
+  lying_data[lying_data.size() - 4] = 1;
+  lying_data[lying_data.size() - 3] = 0;
+  lying_data[lying_data.size() - 2] = 0;
+  lying_data[lying_data.size() - 1] = 0;
+  EXPECT_FALSE(GzipUncompressWithLimit(
+      base::as_bytes(base::span<const char>(lying_data)), kSize, &output,
+      &result));
+  EXPECT_EQ(kSize, result.size);
+  EXPECT_FALSE(result.limit_exceeded);
+
+  // Truncated input keeps the output decoded so far.
+  EXPECT_FALSE(GzipUncompressWithLimit(input.first(input.size() - 10), kSize,
+                                       &output, &result));
+  EXPECT_TRUE(result.truncated);
+  EXPECT_EQ(output.size(), result.size);
+  EXPECT_EQ(data.substr(0, result.size), output);
+}
+
 TEST(CompressionUtilsTest, InPlace) {
   const std::string original_data(reinterpret_cast<const char*>(kData),
                                   std::size(kData));
@@ -96,4 +226,114 @@ TEST(CompressionUtilsTest, InPlace) {
   EXPECT_EQ(original_data, data);
 }
 
+TEST(CompressionUtilsTest, StreamingCompression) {
+  const std::string data(reinterpret_cast<const char*>(kData),
+                         std::size(kData));
+  std::string compressed_data;
+  auto append = [&](base::span<const uint8_t> output) {
+    compressed_data.append(output.begin(), output.end());
+    return true;
+  };
+
+  // The output matches GzipCompress(), whatever the input pieces, and the
+  // compressor can be reused.
+  GzipCompressor compressor;
+  for (size_t piece : {1, 4, 100}) {
+    compressed_data.clear();
+    compressor.Reset();
+    base::span<const uint8_t> input(kData);
+    while (!input.empty()) {
+      size_t size = std::min(piece, input.size());
+      EXPECT_TRUE(compressor.Write(input.first(size), append));
+      input = input.subspan(size);
+    }
+    EXPECT_TRUE(compressor.Finish(append));
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(kCompressedData),
+                          std::size(kCompressedData)),
+              compressed_data);
+  }
+  EXPECT_FALSE(compressor.Write(kData, append));
+
+  std::string uncompressed_data;
+  EXPECT_TRUE(GzipUncompress(compressed_data, &uncompressed_data));
+  EXPECT_EQ(data, uncompressed_data);
+}
+
+TEST(CompressionUtilsTest, StreamingUncompression) {
+  const size_t kSize = 300 * 1024;
+  std::string data(kSize, 0);
+  for (size_t i = 0; i < kSize; ++i)
+    data[i] = static_cast<char>((i * 13) % 251 + (i >> 12));
+  std::string compressed_data;
+  EXPECT_TRUE(GzipCompress(data, &compressed_data));
+
+  std::string uncompressed_data;
+  auto append = [&](base::span<const uint8_t> output) {
+    uncompressed_data.append(output.begin(), output.end());
+    return true;
+  };
+
+  // Two concatenated members, fed one byte, then 1000 bytes at a time.
+  const std::string two_members = compressed_data + compressed_data;
+  GzipDecompressor decompressor;
+  for (size_t piece : {1, 1000}) {
+    uncompressed_data.clear();
+    decompressor.Reset();
+    base::span<const uint8_t> input =
+        base::as_bytes(base::span<const char>(two_members));
+    while (!input.empty()) {
+      size_t size = std::min(piece, input.size());
+      EXPECT_TRUE(decompressor.Write(input.first(size), append));
+      input = input.subspan(size);
+    }
+    EXPECT_TRUE(decompressor.Finish());
+    EXPECT_EQ(data + data, uncompressed_data);
+  }
+
+  // Zero padding or garbage after a member is ignored, as by
+  // GzipUncompress(), whatever the pieces it comes in.
+  for (const std::string& trailing :
+       {std::string(100, '\0'), std::string("\x1f\0garbage\0\0\0", 12)}) {
+    const std::string padded = compressed_data + trailing;
+    std::string padded_uncompressed;
+    EXPECT_TRUE(GzipUncompress(padded, &padded_uncompressed));
+    EXPECT_EQ(data, padded_uncompressed);
+    for (size_t piece : {1, 1000}) {
+      uncompressed_data.clear();
+      decompressor.Reset();
+      base::span<const uint8_t> input =
+          base::as_bytes(base::span<const char>(padded));
+      while (!input.empty()) {
+        size_t size = std::min(piece, input.size());
+        EXPECT_TRUE(decompressor.Write(input.first(size), append));
+        input = input.subspan(size);
+      }
+      EXPECT_TRUE(decompressor.Finish());
+      EXPECT_EQ(data, uncompressed_data);
+    }
+  }
+
+  // Truncated input does not finish.
+  decompressor.Reset();
+  EXPECT_TRUE(decompressor.Write(
+      base::as_bytes(base::span<const char>(compressed_data))
+          .first(compressed_data.size() - 1),
+      append));
+  EXPECT_FALSE(decompressor.Finish());
+
+  // Corrupt input fails.
+  decompressor.Reset();
+  std::string corrupt_data = compressed_data;
+  corrupt_data[compressed_data.size() / 2] ^= 0x55;
+  bool ok = decompressor.Write(
+      base::as_bytes(base::span<const char>(corrupt_data)), append);
+  EXPECT_FALSE(ok && decompressor.Finish());
+
+  // The sink can abort.
+  decompressor.Reset();
+  EXPECT_FALSE(decompressor.Write(
+      base::as_bytes(base::span<const char>(compressed_data)),
+      [](base::span<const uint8_t>) { return false; }));
+}
+
 }  // namespace compression
@@ -19,6 +19,7 @@
 
 #include <stdio.h>
 #include "zlib.h"
+#include "zprobes.h"
 #ifdef STDC
 #  include <string.h>
 #  include <stdlib.h>
@@ -186,6 +187,8 @@ typedef struct {
     z_off64_t start;        /* where the gzip data started, for rewinding */
     int eof;                /* true if end of input file reached */
     int past;               /* true if read requested past end */
+    unsigned char *line;    /* gzgetline() buffer for lines that span refills */
+    z_size_t line_size;     /* allocated size of line, zero if none */
         /* just for writing */
     int level;              /* compression level */
     int strategy;           /* compression strategy */
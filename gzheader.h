@@ -0,0 +1,179 @@
+/* gzheader.h -- one-pass gzip header and trailer parsing and writing
+ *
+ * Copyright 2026 The Chromium Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the Chromium source repository LICENSE file.
+ */
+
+/* The gzip wrapper (RFC 1952) is parsed byte by byte by inflate's HEAD ...
+ * HCRC states, which must cope with a header split across any number of
+ * calls. When the whole header is at hand, as it nearly always is, these
+ * helpers read it in one pass instead: fixed fields with plain loads, and the
+ * zero-terminated name and comment with memchr(), which the C library
+ * vectorizes. They are used by inflate(), and so by gzread, and by the
+ * google/ compression helpers, and need only the public zlib.h types.
+ */
+
+#ifndef GZHEADER_H
+#define GZHEADER_H
+
+#include <string.h>
+
+#include "zlib.h"
+
+#ifndef INLINE
+#if defined(_MSC_VER) && !defined(__clang__)
+#define INLINE __inline
+#else
+#define INLINE inline
+#endif
+#endif
+
+/* Header flags (FLG). */
+#define GZHDR_FTEXT 0x01
+#define GZHDR_FHCRC 0x02
+#define GZHDR_FEXTRA 0x04
+#define GZHDR_FNAME 0x08
+#define GZHDR_FCOMMENT 0x10
+#define GZHDR_FRESERVED 0xe0
+
+/* Sizes of the fixed part of the header, and of the trailer. */
+#define GZHDR_FIXED_SIZE 10
+#define GZHDR_TRAILER_SIZE 8
+
+/* gzhdr_parse() results. */
+#define GZHDR_OK 0      /* a complete, valid header */
+#define GZHDR_MORE 1    /* a valid header so far, which continues past len */
+#define GZHDR_BAD (-1)  /* not a gzip header, or an unsupported one */
+
+/* A gzip header parsed by gzhdr_parse(). The extra field, name and comment
+ * are given as offsets from the start of the header, which are 0 when the
+ * field is absent. */
+typedef struct {
+    unsigned flags;     /* FLG */
+    uLong time;         /* MTIME */
+    int xflags;         /* XFL */
+    int os;             /* OS */
+    unsigned extra_len; /* XLEN, if FEXTRA */
+    z_size_t extra;     /* offset of the extra field, if FEXTRA */
+    z_size_t name;      /* offset of the zero-terminated name, if FNAME */
+    z_size_t comment;   /* offset of the zero-terminated comment */
+    unsigned hcrc;      /* the stored header CRC-16, if FHCRC */
+    z_size_t length;    /* the size of the whole header, including HCRC */
+} gzhdr_info;
+
+static INLINE uLong gzhdr_get32(const Bytef *p) {
+    return (uLong)p[0] | ((uLong)p[1] << 8) | ((uLong)p[2] << 16) |
+           ((uLong)p[3] << 24);
+}
+
+static INLINE void gzhdr_put32(Bytef *p, uLong value) {
+    p[0] = (Bytef)value;
+    p[1] = (Bytef)(value >> 8);
+    p[2] = (Bytef)(value >> 16);
+    p[3] = (Bytef)(value >> 24);
+}
+
+/* Parses the gzip header at buf[0..len) in one pass. Returns GZHDR_OK and
+ * fills *info if the header is complete, GZHDR_MORE if len ends inside a
+ * header that is valid so far, and GZHDR_BAD if buf does not start with a
+ * gzip header with the deflate method and no reserved flags. The header CRC,
+ * if any, is returned but not checked; see gzhdr_check_hcrc(). */
+static INLINE int gzhdr_parse(const Bytef *buf, z_size_t len,
+                              gzhdr_info *info) {
+    const Bytef *end;
+    z_size_t pos;
+
+    if (len >= 1 && buf[0] != 0x1f)
+        return GZHDR_BAD;
+    if (len >= 2 && buf[1] != 0x8b)
+        return GZHDR_BAD;
+    if (len >= 3 && buf[2] != Z_DEFLATED)
+        return GZHDR_BAD;
+    if (len >= 4 && (buf[3] & GZHDR_FRESERVED))
+        return GZHDR_BAD;
+    if (len < GZHDR_FIXED_SIZE)
+        return GZHDR_MORE;
+
+    info->flags = buf[3];
+    info->time = gzhdr_get32(buf + 4);
+    info->xflags = buf[8];
+    info->os = buf[9];
+    info->extra_len = 0;
+    info->extra = info->name = info->comment = 0;
+    info->hcrc = 0;
+    pos = GZHDR_FIXED_SIZE;
+
+    if (info->flags & GZHDR_FEXTRA) {
+        if (len - pos < 2)
+            return GZHDR_MORE;
+        info->extra_len = buf[pos] | ((unsigned)buf[pos + 1] << 8);
+        info->extra = pos + 2;
+        if (len - info->extra < info->extra_len)
+            return GZHDR_MORE;
+        pos = info->extra + info->extra_len;
+    }
+    if (info->flags & GZHDR_FNAME) {
+        end = (const Bytef *)memchr(buf + pos, 0, len - pos);
+        if (end == NULL)
+            return GZHDR_MORE;
+        info->name = pos;
+        pos = (z_size_t)(end - buf) + 1;
+    }
+    if (info->flags & GZHDR_FCOMMENT) {
+        end = (const Bytef *)memchr(buf + pos, 0, len - pos);
+        if (end == NULL)
+            return GZHDR_MORE;
+        info->comment = pos;
+        pos = (z_size_t)(end - buf) + 1;
+    }
+    if (info->flags & GZHDR_FHCRC) {
+        if (len - pos < 2)
+            return GZHDR_MORE;
+        info->hcrc = buf[pos] | ((unsigned)buf[pos + 1] << 8);
+        pos += 2;
+    }
+    info->length = pos;
+    return GZHDR_OK;
+}
+
+/* Returns 1 if the header parsed from buf has no header CRC, or a correct
+ * one, else 0. */
+static INLINE int gzhdr_check_hcrc(const Bytef *buf, const gzhdr_info *info) {
+    if (!(info->flags & GZHDR_FHCRC))
+        return 1;
+    return (crc32_z(0L, buf, info->length - 2) & 0xffff) == info->hcrc;
+}
+
+/* Returns the XFL deflate() writes for a level (0..9) and strategy. */
+static INLINE int gzhdr_xflags(int level, int strategy) {
+    return level == 9 ? 2 : strategy >= Z_HUFFMAN_ONLY || level < 2 ? 4 : 0;
+}
+
+/* Writes the 10 byte header deflate() writes when no gz_header is set: no
+ * name, time or extra field, with the given XFL and OS code. Returns the
+ * number of bytes written. */
+static INLINE z_size_t gzhdr_write(Bytef *buf, int xflags, int os) {
+    buf[0] = 0x1f;
+    buf[1] = 0x8b;
+    buf[2] = Z_DEFLATED;
+    buf[3] = 0;
+    gzhdr_put32(buf + 4, 0);
+    buf[8] = (Bytef)xflags;
+    buf[9] = (Bytef)os;
+    return GZHDR_FIXED_SIZE;
+}
+
+/* Writes the trailer: the CRC-32 of the uncompressed data, then its length
+ * modulo 2^32. */
+static INLINE void gzhdr_write_trailer(Bytef *buf, uLong crc, uLong isize) {
+    gzhdr_put32(buf, crc);
+    gzhdr_put32(buf + 4, isize);
+}
+
+/* Reads the ISIZE field of the trailer that ends at end. */
+static INLINE uLong gzhdr_trailer_size(const Bytef *end) {
+    return gzhdr_get32(end - 4);
+}
+
+#endif /* GZHEADER_H */
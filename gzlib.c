@@ -107,6 +107,8 @@ local gzFile gz_open(const void *path, int fd, const char *mode) {
     state->size = 0;            /* no buffers allocated yet */
     state->want = GZBUFSIZE;    /* requested buffer size */
     state->msg = NULL;          /* no error message yet */
+    state->line = NULL;         /* no gzgetline() buffer yet */
+    state->line_size = 0;
 
     /* interpret mode */
     state->mode = GZ_NONE;
@@ -254,6 +256,7 @@ local gzFile gz_open(const void *path, int fd, const char *mode) {
 
     /* initialize stream */
     gz_reset(state);
+    Z_PROBE4(gz_open, state, state->path, state->fd, state->mode);
 
     /* return stream */
     return (gzFile)state;
@@ -555,6 +555,99 @@ char * ZEXPORT gzgets(gzFile file, char *buf, int len) {
     return str;
 }
 
+/* Make room for at least need bytes in state->line, keeping its contents.
+   Return -1 on failure, 0 on success. */
+local int gz_line_room(gz_statep state, z_size_t need) {
+    z_size_t size;
+    unsigned char *line;
+
+    if (need <= state->line_size)
+        return 0;
+    size = state->line_size ? state->line_size : (z_size_t)state->size << 1;
+    while (size < need)
+        size = size > (z_size_t)-1 >> 1 ? need : size << 1;
+    line = (unsigned char *)realloc(state->line, size);
+    if (line == NULL) {
+        gz_error(state, Z_MEM_ERROR, "out of memory");
+        return -1;
+    }
+    state->line = line;
+    state->line_size = size;
+    return 0;
+}
+
+/* -- see zlib.h -- */
+const char * ZEXPORT gzgetline(gzFile file, z_size_t *len) {
+    unsigned n;
+    z_size_t got;
+    unsigned char *line, *eol;
+    gz_statep state;
+
+    /* check parameters and get internal structure */
+    if (file == NULL || len == NULL)
+        return NULL;
+    state = (gz_statep)file;
+
+    /* check that we're reading and that there's no (serious) error */
+    if (state->mode != GZ_READ ||
+        (state->err != Z_OK && state->err != Z_BUF_ERROR))
+        return NULL;
+
+    /* process a skip request */
+    if (state->seek) {
+        state->seek = 0;
+        if (gz_skip(state, state->skip) == -1)
+            return NULL;
+    }
+
+    /* assure that something is in the output buffer */
+    if (state->x.have == 0 && gz_fetch(state) == -1)
+        return NULL;                    /* error */
+    if (state->x.have == 0) {           /* end of file */
+        state->past = 1;                /* read past end */
+        return NULL;
+    }
+
+    /* return the line in place if its end-of-line is in the output buffer --
+       memchr() is vectorized by the C library */
+    eol = (unsigned char *)memchr(state->x.next, '\n', state->x.have);
+    if (eol != NULL) {
+        line = state->x.next;
+        n = (unsigned)(eol - line) + 1;
+        state->x.have -= n;
+        state->x.next += n;
+        state->x.pos += n;
+        *len = n;
+        return (const char *)line;
+    }
+
+    /* otherwise gather the line in state->line, one output buffer at a time,
+       up to the end-of-line or the end of the file */
+    got = 0;
+    for (;;) {
+        n = eol == NULL ? state->x.have :
+                          (unsigned)(eol - state->x.next) + 1;
+        if (gz_line_room(state, got + n) == -1)
+            return NULL;
+        memcpy(state->line + got, state->x.next, n);
+        state->x.have -= n;
+        state->x.next += n;
+        state->x.pos += n;
+        got += n;
+        if (eol != NULL)
+            break;
+        if (gz_fetch(state) == -1)
+            return NULL;
+        if (state->x.have == 0) {       /* end of file */
+            state->past = 1;
+            break;
+        }
+        eol = (unsigned char *)memchr(state->x.next, '\n', state->x.have);
+    }
+    *len = got;
+    return (const char *)state->line;
+}
+
 /* -- see zlib.h -- */
 int ZEXPORT gzdirect(gzFile file) {
     gz_statep state;
@@ -586,6 +679,7 @@ int ZEXPORT gzclose_r(gzFile file) {
     /* check that we're reading */
     if (state->mode != GZ_READ)
         return Z_STREAM_ERROR;
+    Z_PROBE3(gz_close, state, state->mode, state->x.pos);
 
     /* free memory and close file */
     if (state->size) {
@@ -593,6 +687,7 @@ int ZEXPORT gzclose_r(gzFile file) {
         free(state->out);
         free(state->in);
     }
+    free(state->line);
     err = state->err == Z_BUF_ERROR ? Z_BUF_ERROR : Z_OK;
     gz_error(state, Z_OK, NULL);
     free(state->path);
@@ -352,6 +352,173 @@ int ZEXPORT gzputs(gzFile file, const char *s) {
     return put < len ? -1 : (int)len;
 }
 
+/* Longest output of gzputint() and gzputtime(). */
+#define GZ_PUT_MAX 20
+
+/* Start a gzputint() or gzputtime(): check the state and return where to
+   format up to GZ_PUT_MAX bytes. That is the end of the pending input, since
+   the input buffer is double-sized for gzprintf() and holds at most
+   state->size bytes between calls, or scratch if the buffer is too small.
+   Return NULL on error. */
+local char *gz_put_begin(gz_statep state, char *scratch) {
+    z_streamp strm = &(state->strm);
+
+    /* check that we're writing and that there's no error */
+    if (state->mode != GZ_WRITE || state->err != Z_OK)
+        return NULL;
+
+    /* make sure we have some buffer space */
+    if (state->size == 0 && gz_init(state) == -1)
+        return NULL;
+
+    /* check for seek request */
+    if (state->seek) {
+        state->seek = 0;
+        if (gz_zero(state, state->skip) == -1)
+            return NULL;
+    }
+
+    if (state->size < GZ_PUT_MAX)
+        return scratch;
+    if (strm->avail_in == 0)
+        strm->next_in = state->in;
+    return (char *)strm->next_in + strm->avail_in;
+}
+
+/* Finish a gzputint() or gzputtime() that formatted len bytes at next. As in
+   gzvprintf(), the first state->size bytes are compressed once there are that
+   many, so many short records go to deflate() at a time. Return len, or -1 on
+   error. */
+local int gz_put_end(gz_statep state, const char *next, unsigned len,
+                     const char *scratch) {
+    unsigned left;
+    z_streamp strm = &(state->strm);
+
+    if (next == scratch)
+        return gz_write(state, next, len) < len ? -1 : (int)len;
+    strm->avail_in += len;
+    state->x.pos += len;
+    if (strm->avail_in >= state->size) {
+        left = strm->avail_in - state->size;
+        strm->avail_in = state->size;
+        if (gz_comp(state, Z_NO_FLUSH) == -1)
+            return -1;
+        memmove(state->in, state->in + state->size, left);
+        strm->next_in = state->in;
+        strm->avail_in = left;
+    }
+    return (int)len;
+}
+
+/* Write value in decimal to next, and return the number of bytes written.
+   Negative values are reduced digit by digit so that the most negative one
+   needs no special case. */
+local unsigned gz_format_int(char *next, z_off64_t value) {
+    z_off64_t rest;
+    unsigned len, n;
+
+    len = value < 0;
+    rest = value;
+    do {
+        len++;
+        rest /= 10;
+    } while (rest);
+    if (value < 0)
+        next[0] = '-';
+    n = len;
+    do {
+        rest = value % 10;
+        next[--n] = (char)('0' + (rest < 0 ? -rest : rest));
+        value /= 10;
+    } while (value);
+    return len;
+}
+
+/* Write the two digit decimal value to next. */
+local void gz_format_2(char *next, unsigned value) {
+    next[0] = (char)('0' + value / 10);
+    next[1] = (char)('0' + value % 10);
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzputint(gzFile file, z_off64_t value) {
+    char scratch[GZ_PUT_MAX];
+    char *next;
+    gz_statep state;
+
+    /* get internal structure */
+    if (file == NULL)
+        return -1;
+    state = (gz_statep)file;
+
+    next = gz_put_begin(state, scratch);
+    if (next == NULL)
+        return -1;
+    return gz_put_end(state, next, gz_format_int(next, value), scratch);
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzputtime(gzFile file, z_off64_t seconds) {
+    char scratch[GZ_PUT_MAX];
+    char *next;
+    z_off64_t rest;
+    long days, era, doe, yoe, doy, year, month, mp;
+    unsigned secs;
+    gz_statep state;
+
+    /* get internal structure */
+    if (file == NULL)
+        return -1;
+    state = (gz_statep)file;
+
+    /* split into days and seconds of the day, rounding the days down, and
+       check that the year has four digits: 0000-01-01 is day -719528 and
+       9999-12-31 is day 2932896 */
+    rest = seconds % 86400;
+    if (rest < 0)
+        rest += 86400;
+    secs = (unsigned)rest;
+    rest = (seconds - rest) / 86400;
+    if (rest < -719528 || rest > 2932896) {
+        if (state->mode == GZ_WRITE && state->err == Z_OK)
+            gz_error(state, Z_STREAM_ERROR, "time out of range");
+        return -1;
+    }
+
+    days = (long)rest;
+
+    next = gz_put_begin(state, scratch);
+    if (next == NULL)
+        return -1;
+
+    /* convert days since 1970-01-01 to a proleptic Gregorian date, counting
+       400 year eras from 0000-03-01 so that leap days fall at the end */
+    days += 719468;
+    era = (days >= 0 ? days : days - 146096) / 146097;
+    doe = days - era * 146097;
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = yoe + era * 400 + (month <= 2);
+
+    /* YYYY-MM-DDTHH:MM:SSZ */
+    gz_format_2(next, (unsigned)year / 100);
+    gz_format_2(next + 2, (unsigned)year % 100);
+    next[4] = '-';
+    gz_format_2(next + 5, (unsigned)month);
+    next[7] = '-';
+    gz_format_2(next + 8, (unsigned)(doy - (153 * mp + 2) / 5 + 1));
+    next[10] = 'T';
+    gz_format_2(next + 11, secs / 3600);
+    next[13] = ':';
+    gz_format_2(next + 14, secs / 60 % 60);
+    next[16] = ':';
+    gz_format_2(next + 17, secs % 60);
+    next[19] = 'Z';
+    return gz_put_end(state, next, 20, scratch);
+}
+
 #if defined(STDC) || defined(Z_HAVE_STDARG_H)
 #include <stdarg.h>
 
@@ -611,6 +778,7 @@ int ZEXPORT gzclose_w(gzFile file) {
         if (gz_zero(state, state->skip) == -1)
             ret = state->err;
     }
+    Z_PROBE3(gz_close, state, state->mode, state->x.pos);
 
     /* flush, free memory, and close file */
     if (gz_comp(state, Z_FINISH) == -1)
@@ -14,6 +14,7 @@
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
+#include "zprobes.h"
 
 /*
    strm provides memory allocation functions in zalloc and zfree, or
@@ -53,6 +54,10 @@ int ZEXPORT inflateBackInit_(z_streamp strm, int windowBits,
     if (state == Z_NULL) return Z_MEM_ERROR;
     Tracev((stderr, "inflate: allocated\n"));
     strm->state = (struct internal_state FAR *)state;
+#ifdef ZLIB_STATS
+    zmemzero((Bytef *)&state->stats, sizeof(state->stats));
+    state->back_strm = strm;
+#endif
     state->dmax = 32768U;
     state->wbits = (uInt)windowBits;
     state->wsize = 1U << windowBits;
@@ -286,6 +291,7 @@ int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
             NEEDBITS(3);
             state->last = BITS(1);
             DROPBITS(1);
+            Z_PROBE3(inflate_block, strm, BITS(2), state->last);
             switch (BITS(2)) {
             case 0:                             /* stored block */
                 Tracev((stderr, "inflate:     stored block%s\n",
@@ -337,6 +343,7 @@ int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
                 left -= copy;
                 put += copy;
                 state->length -= copy;
+                INFLATE_STAT(state, slow_bytes, copy);
             }
             Tracev((stderr, "inflate:       stored end\n"));
             state->mode = TYPE;
@@ -505,6 +512,7 @@ int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
                 ROOM();
                 *put++ = (unsigned char)(state->length);
                 left--;
+                INFLATE_STAT(state, slow_bytes, 1);
                 state->mode = LEN;
                 break;
             }
@@ -586,6 +594,7 @@ int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
                 if (copy > state->length) copy = state->length;
                 state->length -= copy;
                 left -= copy;
+                INFLATE_STAT(state, slow_bytes, copy);
                 do {
                     *put++ = *from++;
                 } while (--copy);
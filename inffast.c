@@ -297,6 +297,8 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
     hold &= (1U << bits) - 1;
 
     /* update state and return */
+    INFLATE_STAT(state, fast_bytes, (z_size_t)(out - strm->next_out));
+    INFLATE_STAT(state, fast_calls, 1);
     strm->next_in = in;
     strm->next_out = out;
     strm->avail_in = (unsigned)(in < last ?
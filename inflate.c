@@ -84,6 +84,8 @@
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
+#include "zprobes.h"
+#include "gzheader.h"
 
 #ifdef MAKEFIXED
 #  ifndef BUILDFIXED
@@ -123,6 +125,9 @@ int ZEXPORT inflateResetKeep(z_streamp strm) {
     state->lencode = state->distcode = state->next = state->codes;
     state->sane = 1;
     state->back = -1;
+#ifdef ZLIB_STATS
+    zmemzero((Bytef *)&state->stats, sizeof(state->stats));
+#endif
     Tracev((stderr, "inflate: reset\n"));
     return Z_OK;
 }
@@ -205,6 +210,9 @@ int ZEXPORT inflateInit2_(z_streamp strm, int windowBits,
     Tracev((stderr, "inflate: allocated\n"));
     strm->state = (struct internal_state FAR *)state;
     state->strm = strm;
+#ifdef ZLIB_STATS
+    state->back_strm = Z_NULL;
+#endif
     state->window = Z_NULL;
     state->mode = HEAD;     /* to pass state test in inflateReset2() */
     state->check = 1L;      /* 1L is the result of adler32() zero length data */
@@ -371,6 +379,7 @@ local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy) {
     unsigned dist;
 
     state = (struct inflate_state FAR *)strm->state;
+    INFLATE_STAT(state, window_updates, 1);
 
     /* if it hasn't been done already, allocate space for the window */
     if (state->window == Z_NULL) {
@@ -412,6 +421,64 @@ local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy) {
     return 0;
 }
 
+#ifdef GUNZIP
+/*
+   Reads a gzip header that is entirely in next[0..have) in one pass, setting
+   state->flags and filling in state->head as the HEAD ... HCRC states would.
+   Returns the length of the header, or 0 if it is incomplete or invalid, in
+   which case those states decode it a byte at a time and report any error.
+ */
+local unsigned gzheader_fast(struct inflate_state FAR *state,
+                             z_const unsigned char FAR *next, unsigned have) {
+    gzhdr_info info;
+    gz_headerp head;
+    unsigned len;
+
+    if (gzhdr_parse(next, have, &info) != GZHDR_OK)
+        return 0;
+    if ((state->wrap & 4) && !gzhdr_check_hcrc(next, &info))
+        return 0;
+    state->flags = (int)(Z_DEFLATED | (info.flags << 8));
+    head = state->head;
+    if (head != Z_NULL) {
+        head->text = (int)(info.flags & GZHDR_FTEXT);
+        head->time = info.time;
+        head->xflags = info.xflags;
+        head->os = info.os;
+        if (info.flags & GZHDR_FEXTRA) {
+            head->extra_len = info.extra_len;
+            if (head->extra != Z_NULL)
+                zmemcpy(head->extra, next + info.extra,
+                        info.extra_len < head->extra_max ?
+                        info.extra_len : head->extra_max);
+        }
+        else
+            head->extra = Z_NULL;
+        if (info.flags & GZHDR_FNAME) {
+            if (head->name != Z_NULL) {
+                len = (unsigned)strlen((const char *)next + info.name) + 1;
+                zmemcpy(head->name, next + info.name,
+                        len < head->name_max ? len : head->name_max);
+            }
+        }
+        else
+            head->name = Z_NULL;
+        if (info.flags & GZHDR_FCOMMENT) {
+            if (head->comment != Z_NULL) {
+                len = (unsigned)strlen((const char *)next + info.comment) + 1;
+                zmemcpy(head->comment, next + info.comment,
+                        len < head->comm_max ? len : head->comm_max);
+            }
+        }
+        else
+            head->comment = Z_NULL;
+        head->hcrc = (int)((info.flags >> 1) & 1);
+        head->done = 1;
+    }
+    return (unsigned)info.length;
+}
+#endif
+
 /* Macros for inflate(): */
 
 /* check function to use adler32() for zlib or crc32() for gzip */
@@ -625,6 +692,19 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                 state->mode = TYPEDO;
                 break;
             }
+#ifdef GUNZIP
+            if ((state->wrap & 2) && bits == 0 &&
+                have >= GZHDR_FIXED_SIZE &&
+                (copy = gzheader_fast(state, next, have)) != 0) {
+                if (state->wbits == 0)
+                    state->wbits = 15;
+                next += copy;
+                have -= copy;
+                strm->adler = state->check = crc32(0L, Z_NULL, 0);
+                state->mode = TYPE;
+                break;
+            }
+#endif
             NEEDBITS(16);
 #ifdef GUNZIP
             if ((state->wrap & 2) && hold == 0x8b1f) {  /* gzip header */
@@ -812,6 +892,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             NEEDBITS(32);
             strm->adler = state->check = ZSWAP32(hold);
             INITBITS();
+            INFLATE_STAT(state, dictionary_requests, 1);
             state->mode = DICT;
                 /* fallthrough */
         case DICT:
@@ -834,16 +915,19 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             NEEDBITS(3);
             state->last = BITS(1);
             DROPBITS(1);
+            Z_PROBE3(inflate_block, strm, BITS(2), state->last);
             switch (BITS(2)) {
             case 0:                             /* stored block */
                 Tracev((stderr, "inflate:     stored block%s\n",
                         state->last ? " (last)" : ""));
+                INFLATE_STAT(state, stored_blocks, 1);
                 state->mode = STORED;
                 break;
             case 1:                             /* fixed block */
                 fixedtables(state);
                 Tracev((stderr, "inflate:     fixed codes block%s\n",
                         state->last ? " (last)" : ""));
+                INFLATE_STAT(state, fixed_blocks, 1);
                 state->mode = LEN_;             /* decode codes */
                 if (flush == Z_TREES) {
                     DROPBITS(2);
@@ -853,6 +937,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             case 2:                             /* dynamic block */
                 Tracev((stderr, "inflate:     dynamic codes block%s\n",
                         state->last ? " (last)" : ""));
+                INFLATE_STAT(state, dynamic_blocks, 1);
                 state->mode = TABLE;
                 break;
             case 3:
@@ -890,6 +975,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                 next += copy;
                 left -= copy;
                 put += copy;
+                INFLATE_STAT(state, slow_bytes, copy);
                 state->length -= copy;
                 break;
             }
@@ -1018,6 +1104,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                 break;
             }
             Tracev((stderr, "inflate:       codes ok\n"));
+            INFLATE_STAT(state, table_builds, 1);
             state->mode = LEN_;
             if (flush == Z_TREES) goto inf_leave;
                 /* fallthrough */
@@ -1149,6 +1236,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                     if (copy > left) copy = left;
                     left -= copy;
                     state->length -= copy;
+                    INFLATE_STAT(state, slow_bytes, copy);
                     do {
                         *put++ = 0;
                     } while (--copy);
@@ -1171,6 +1259,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             if (copy > left) copy = left;
             left -= copy;
             state->length -= copy;
+            INFLATE_STAT(state, slow_bytes, copy);
             do {
                 *put++ = *from++;
             } while (--copy);
@@ -1180,6 +1269,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             if (left == 0) goto inf_leave;
             *put++ = (unsigned char)(state->length);
             left--;
+            INFLATE_STAT(state, slow_bytes, 1);
             state->mode = LEN;
             break;
         case CHECK:
@@ -1277,6 +1367,33 @@ int ZEXPORT inflateEnd(z_streamp strm) {
     return Z_OK;
 }
 
+int ZEXPORT inflateGetStats(z_streamp strm, z_inflate_stats *stats) {
+#ifdef ZLIB_STATS
+    struct inflate_state FAR *state;
+    if (stats == Z_NULL) return Z_STREAM_ERROR;
+    if (inflateStateCheck(strm) &&
+        (strm == Z_NULL || strm->state == Z_NULL ||
+         ((struct inflate_state FAR *)strm->state)->back_strm != strm))
+        return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    *stats = state->stats;
+    if (state->back_strm == strm) {
+        /* inflateBack() does not update the stream totals */
+        stats->total_in = 0;
+        stats->total_out = stats->fast_bytes + stats->slow_bytes;
+    }
+    else {
+        stats->total_in = strm->total_in;
+        stats->total_out = strm->total_out;
+    }
+    return Z_OK;
+#else
+    (void)strm;
+    (void)stats;
+    return Z_STREAM_ERROR;
+#endif
+}
+
 int ZEXPORT inflateGetDictionary(z_streamp strm, Bytef *dictionary,
                                  uInt *dictLength) {
     struct inflate_state FAR *state;
@@ -123,4 +123,17 @@ struct inflate_state {
     int sane;                   /* if false, allow invalid distance too far */
     int back;                   /* bits back of last unprocessed length/lit */
     unsigned was;               /* initial length of match */
+#ifdef ZLIB_STATS
+    z_inflate_stats stats;      /* counters returned by inflateGetStats() */
+    z_streamp back_strm;        /* strm if set up by inflateBackInit(), which
+                                   leaves strm above unset */
+#endif
 };
+
+#ifdef ZLIB_STATS
+#  define INFLATE_STAT(state, counter, n) ((state)->stats.counter += (n))
+#else
+#  define INFLATE_STAT(state, counter, n)
+#endif
+/* Add n to an inflateGetStats() counter: compiles to nothing without
+   ZLIB_STATS. */
@@ -35,6 +35,7 @@
 /* #define GEN_TREES_H */
 
 #include "deflate.h"
+#include "zprobes.h"
 
 #ifdef ZLIB_DEBUG
 #  include <ctype.h>
@@ -858,6 +859,9 @@ local void send_all_trees(deflate_state *s, int lcodes, int dcodes,
 void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
                                     ulg stored_len, int last) {
     send_bits(s, (STORED_BLOCK<<1) + last, 3);  /* send block type */
+    DEFLATE_STAT(s, stored_blocks, 1);
+    Z_PROBE5(deflate_block, s->strm, STORED_BLOCK, stored_len, stored_len + 4,
+             last);
     bi_windup(s);        /* align on byte boundary */
     put_short(s, (ush)stored_len);
     put_short(s, (ush)~stored_len);
@@ -885,6 +889,7 @@ void ZLIB_INTERNAL _tr_flush_bits(deflate_state *s) {
  */
 void ZLIB_INTERNAL _tr_align(deflate_state *s) {
     send_bits(s, STATIC_TREES<<1, 3);
+    Z_PROBE5(deflate_block, s->strm, STATIC_TREES, 0, 2, 0);
     send_code(s, END_BLOCK, static_ltree);
 #ifdef ZLIB_DEBUG
     s->compressed_len += 10L; /* 3 for block type, 7 for EOB */
@@ -1053,16 +1058,25 @@ void ZLIB_INTERNAL _tr_flush_block(deflate_state *s, charf *buf,
          * transform a block into a stored block.
          */
         _tr_stored_block(s, buf, stored_len, last);
+        s->block_stored = 1;
 
     } else if (static_lenb == opt_lenb) {
+        s->block_stored = 0;
         send_bits(s, (STATIC_TREES<<1) + last, 3);
+        DEFLATE_STAT(s, fixed_blocks, 1);
+        Z_PROBE5(deflate_block, s->strm, STATIC_TREES, stored_len,
+                 static_lenb, last);
         compress_block(s, (const ct_data *)static_ltree,
                        (const ct_data *)static_dtree);
 #ifdef ZLIB_DEBUG
         s->compressed_len += 3 + s->static_len;
 #endif
     } else {
+        s->block_stored = 0;
         send_bits(s, (DYN_TREES<<1) + last, 3);
+        DEFLATE_STAT(s, dynamic_blocks, 1);
+        Z_PROBE5(deflate_block, s->strm, DYN_TREES, stored_len, opt_lenb,
+                 last);
         send_all_trees(s, s->l_desc.max_code + 1, s->d_desc.max_code + 1,
                        max_blindex + 1);
         compress_block(s, (const ct_data *)s->dyn_ltree,
@@ -1103,8 +1117,11 @@ int ZLIB_INTERNAL _tr_tally(deflate_state *s, unsigned dist, unsigned lc) {
     if (dist == 0) {
         /* lc is the unmatched char */
         s->dyn_ltree[lc].Freq++;
+        DEFLATE_STAT(s, literals, 1);
     } else {
         s->matches++;
+        DEFLATE_STAT(s, matches, 1);
+        DEFLATE_STAT(s, match_bytes, lc + MIN_MATCH);
         /* Here, lc is the match length - MIN_MATCH */
         dist--;             /* dist = match distance - 1 */
         Assert((ush)dist < (ush)MAX_DIST(s) &&
@@ -62,7 +62,9 @@
 #  define deflateBound          z_deflateBound
 #  define deflateCopy           z_deflateCopy
 #  define deflateEnd            z_deflateEnd
+#  define deflateEstimate       z_deflateEstimate
 #  define deflateGetDictionary  z_deflateGetDictionary
+#  define deflateGetStats       z_deflateGetStats
 #  define deflateInit           z_deflateInit
 #  define deflateInit2          z_deflateInit2
 #  define deflateInit2_         z_deflateInit2_
@@ -95,6 +97,7 @@
 #    define gzfwrite              z_gzfwrite
 #    define gzgetc                z_gzgetc
 #    define gzgetc_               z_gzgetc_
+#    define gzgetline             z_gzgetline
 #    define gzgets                z_gzgets
 #    define gzoffset              z_gzoffset
 #    define gzoffset64            z_gzoffset64
@@ -105,7 +108,9 @@
 #    endif
 #    define gzprintf              z_gzprintf
 #    define gzputc                z_gzputc
+#    define gzputint              z_gzputint
 #    define gzputs                z_gzputs
+#    define gzputtime             z_gzputtime
 #    define gzread                z_gzread
 #    define gzrewind              z_gzrewind
 #    define gzseek                z_gzseek
@@ -126,6 +131,7 @@
 #  define inflateCopy           z_inflateCopy
 #  define inflateEnd            z_inflateEnd
 #  define inflateGetDictionary  z_inflateGetDictionary
+#  define inflateGetStats       z_inflateGetStats
 #  define inflateGetHeader      z_inflateGetHeader
 #  define inflateInit           z_inflateInit
 #  define inflateInit2          z_inflateInit2
@@ -150,8 +156,11 @@
 #  endif
 #  define zError                z_zError
 #  ifndef Z_SOLO
+#    define zallocGetStats        z_zallocGetStats
+#    define zallocTracked         z_zallocTracked
 #    define zcalloc               z_zcalloc
 #    define zcfree                z_zcfree
+#    define zfreeTracked          z_zfreeTracked
 #  endif
 #  define zlibCompileFlags      z_zlibCompileFlags
 #  define zlibVersion           z_zlibVersion
@@ -718,6 +718,69 @@ ZEXTERN int ZEXPORT deflateGetDictionary(z_streamp strm,
    stream state is inconsistent.
 */
 
+typedef struct z_deflate_stats_s {
+    z_size_t total_in;        /* bytes of input consumed */
+    z_size_t total_out;       /* bytes of output produced */
+    z_size_t literals;        /* literal bytes emitted */
+    z_size_t matches;         /* length/distance pairs emitted */
+    z_size_t match_bytes;     /* sum of the match lengths */
+    z_size_t chain_steps;     /* hash chain entries visited by the matcher */
+    z_size_t stored_blocks;   /* blocks emitted with each block type */
+    z_size_t fixed_blocks;
+    z_size_t dynamic_blocks;
+    z_size_t window_slides;   /* times the sliding window was moved down */
+    z_size_t bypassed;        /* bytes stored without looking for matches,
+                                 after the data proved incompressible */
+} z_deflate_stats;
+
+ZEXTERN int ZEXPORT deflateGetStats(z_streamp strm, z_deflate_stats *stats);
+/*
+     Returns the statistics accumulated by deflate since the stream was
+   initialized or last reset.  The average match length is match_bytes /
+   matches.  The counters are only maintained when zlib is compiled with
+   ZLIB_STATS defined, and cost nothing otherwise.
+
+     deflateGetStats returns Z_OK on success, or Z_STREAM_ERROR if the stream
+   state is inconsistent, if stats is Z_NULL, or if zlib was compiled without
+   ZLIB_STATS.
+*/
+
+typedef struct z_deflate_estimate_s {
+    z_size_t sampled;         /* input bytes examined */
+    unsigned entropy;         /* order-0 entropy of those bytes, in
+                                 thousandths of a bit per byte (0..8000) */
+    z_size_t size[10];        /* predicted raw deflate size at levels 0..9 */
+} z_deflate_estimate;
+
+ZEXTERN int ZEXPORT deflateEstimate(const Bytef *source, z_size_t sourceLen,
+                                    z_deflate_estimate *estimate);
+/*
+     Predicts the size deflate would compress source to at each level with the
+   default windowBits, memLevel and strategy, without compressing it, to
+   decide whether to compress at all, or at which level.  Add 6 bytes for a
+   zlib wrapper, or 18 for a gzip wrapper.  Up to 32K of input is examined
+   whole; larger inputs are sampled with one 4K slice per 128K, from two to
+   eight slices: the first at the start of the input and the others spread
+   evenly over the rest, so the cost of an estimate stops growing with the
+   input size at 1M.
+
+     When the byte histogram of the examined bytes is as flat as that of
+   random bytes, the input is predicted stored at every level without looking
+   further.  Otherwise the prediction parses the examined bytes into literals
+   and matches with a small hash table, and costs the codes at their entropy.  It is meant to
+   tell incompressible data (estimate->size[level] close to sourceLen, and
+   estimate->entropy close to 8000) from compressible data, and to rank the
+   levels, not to give exact sizes: on the contrib/bench/zlib_regress corpus
+   it is within 12% under and 35% over the real compressed size, the larger
+   errors being overestimates at the lazy matching levels 4..9.  Matches
+   between slices are not seen, so inputs repeating at distances longer than a
+   slice are overestimated.  Estimating incompressible data takes a fraction
+   of the time compressible data does.
+
+     deflateEstimate returns Z_OK on success, or Z_STREAM_ERROR if estimate is
+   Z_NULL, or source is Z_NULL with a non-zero sourceLen.
+*/
+
 ZEXTERN int ZEXPORT deflateCopy(z_streamp dest,
                                 z_streamp source);
 /*
@@ -969,6 +1032,38 @@ ZEXTERN int ZEXPORT inflateGetDictionary(z_streamp strm,
    stream state is inconsistent.
 */
 
+typedef struct z_inflate_stats_s {
+    z_size_t total_in;        /* bytes of input consumed */
+    z_size_t total_out;       /* bytes of output produced */
+    z_size_t fast_bytes;      /* output decoded by the inflate_fast() loop */
+    z_size_t slow_bytes;      /* output decoded by the inflate() state machine */
+    z_size_t fast_calls;      /* calls to the inflate_fast() loop */
+    z_size_t stored_blocks;   /* blocks decoded with each block type */
+    z_size_t fixed_blocks;
+    z_size_t dynamic_blocks;
+    z_size_t table_builds;    /* decoding tables built for dynamic blocks */
+    z_size_t window_updates;  /* copies of output into the sliding window */
+    z_size_t dictionary_requests;  /* zlib headers that required a dictionary */
+} z_inflate_stats;
+
+ZEXTERN int ZEXPORT inflateGetStats(z_streamp strm, z_inflate_stats *stats);
+/*
+     Returns the statistics accumulated by inflate since the stream was
+   initialized or last reset.  inflate() only runs its fast loop when there is
+   enough input and output space available (see inffast.h), so a high share of
+   slow_bytes indicates that the application buffers are too small.  The
+   stream may also be one set up by inflateBackInit(), whose counters cover
+   its inflateBack() calls.  inflateBack() does not maintain the stream totals,
+   so for such a stream total_in is zero and total_out is the sum of
+   fast_bytes and slow_bytes.
+   The counters are only maintained when zlib is compiled with ZLIB_STATS
+   defined, and cost nothing otherwise.
+
+     inflateGetStats returns Z_OK on success, or Z_STREAM_ERROR if the stream
+   state is inconsistent, if stats is Z_NULL, or if zlib was compiled without
+   ZLIB_STATS.
+*/
+
 ZEXTERN int ZEXPORT inflateSync(z_streamp strm);
 /*
      Skips invalid compressed data until a possible full flush point (see above
@@ -1263,6 +1358,47 @@ ZEXTERN uLong ZEXPORT zlibCompileFlags(void);
      27-31: 0 (reserved)
  */
 
+#ifndef Z_SOLO
+
+                        /* memory accounting functions */
+
+/*
+     The following allocation functions can be set as the zalloc and zfree
+   functions of a z_stream to account for the memory used by that stream.  The
+   stream opaque field must point to a z_alloc_stats structure, zeroed by the
+   application before the stream is initialized, that is updated by each
+   allocation and free.
+*/
+
+typedef struct z_alloc_stats_s {
+    z_size_t current;       /* bytes currently allocated */
+    z_size_t peak;          /* highest value of current */
+    z_size_t total;         /* bytes allocated over the stream lifetime */
+    unsigned long allocs;   /* number of allocations */
+} z_alloc_stats;
+
+ZEXTERN voidpf ZEXPORT zallocTracked(voidpf opaque, uInt items, uInt size);
+ZEXTERN void ZEXPORT zfreeTracked(voidpf opaque, voidpf address);
+/*
+     zallocTracked() allocates items * size bytes with the default zlib memory
+   allocator, and adds them to the z_alloc_stats pointed to by opaque.
+   zfreeTracked() frees memory allocated by zallocTracked() and subtracts its
+   size from the z_alloc_stats.  The memory usage accounted for includes the
+   bytes requested by zlib, but not the allocator's own overhead.
+*/
+
+ZEXTERN int ZEXPORT zallocGetStats(z_streamp strm, z_alloc_stats *stats);
+/*
+     Copies the memory usage of strm into *stats.  The stream may be in use,
+   or ended with deflateEnd() or inflateEnd(), in which case stats->current
+   should be zero and stats->peak is the peak memory usage of the stream.
+
+     zallocGetStats returns Z_OK on success, or Z_STREAM_ERROR if strm or
+   stats is Z_NULL, or if strm does not use zallocTracked().
+*/
+
+#endif /* !Z_SOLO */
+
 #ifndef Z_SOLO
 
                         /* utility functions */
@@ -1543,6 +1679,27 @@ ZEXTERN int ZEXPORT gzputs(gzFile file, const char *s);
      gzputs returns the number of characters written, or -1 in case of error.
 */
 
+ZEXTERN int ZEXPORT gzputint(gzFile file, z_off64_t value);
+/*
+     Compress and write value to file in decimal, with a leading minus sign if
+   it is negative.  Like gzputtime(), and unlike gzprintf(), this formats
+   straight into file's input buffer without going through vsnprintf(), so
+   that records built from several gzputs(), gzputc(), gzputint() and
+   gzputtime() calls cost little more than writing them already formatted.
+
+     gzputint returns the number of characters written, or -1 in case of error.
+*/
+
+ZEXTERN int ZEXPORT gzputtime(gzFile file, z_off64_t seconds);
+/*
+     Compress and write the time seconds after 1970-01-01T00:00:00Z to file as
+   an ISO 8601 UTC time of the form YYYY-MM-DDTHH:MM:SSZ, which is always 20
+   characters.  Leap seconds are not counted, as with POSIX time_t values.
+
+     gzputtime returns 20, or -1 in case of error, including for a time outside
+   the years 0000 to 9999.
+*/
+
 ZEXTERN char * ZEXPORT gzgets(gzFile file, char *buf, int len);
 /*
      Read and decompress bytes from file into buf, until len-1 characters are
@@ -1557,6 +1714,20 @@ ZEXTERN char * ZEXPORT gzgets(gzFile file, char *buf, int len);
    buf are indeterminate.
 */
 
+ZEXTERN const char * ZEXPORT gzgetline(gzFile file, z_size_t *len);
+/*
+     Read and decompress the next line from file, through and including the
+   newline character, or up to the end of file if the last line has no newline.
+   Lines of any length are returned whole.  The line is not copied when it is
+   all in file's output buffer, and is otherwise gathered into a buffer owned
+   by file that grows as needed.
+
+     gzgetline returns a pointer to the line and sets *len to its length, or
+   returns NULL for end-of-file or in case of error, which gzerror() tells
+   apart.  The line is not null-terminated.  It remains valid until the next
+   operation on file.
+*/
+
 ZEXTERN int ZEXPORT gzputc(gzFile file, int c);
 /*
      Compress and write c, converted to an unsigned char, into file.  gzputc
@@ -0,0 +1,58 @@
+/* zprobes.h -- USDT static tracepoints.
+ *
+ * Copyright 2026 The Chromium Authors
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the Chromium source repository LICENSE file.
+ */
+
+/* On Linux, when <sys/sdt.h> is available, zlib marks stream lifecycle and
+ * block boundaries with USDT probes under the "zlib" provider. A probe that
+ * is not attached is a single nop in the instruction stream; its arguments
+ * are values already at hand, which the ELF note locates for the tracer.
+ * Attach with e.g.
+ *
+ *   bpftrace -e 'usdt:/path/to/libz.so:zlib:deflate_block { @[arg1] = sum(arg2); }'
+ *
+ * Probes (arguments in order):
+ *
+ *   deflate_init   strm, level, windowBits, memLevel, strategy
+ *   deflate_end    strm, total_in, total_out
+ *   deflate_block  strm, type (0 stored, 1 fixed, 2 dynamic), input bytes,
+ *                  output bytes, last; once for every block, including the
+ *                  empty ones that flushes emit
+ *   inflate_block  strm, type (0 stored, 1 fixed, 2 dynamic), last
+ *   gz_open        file, path, fd, mode (7247 read, 31153 write)
+ *   gz_close       file, mode, uncompressed position
+ *   unz_open_file  file, method, compressed size, uncompressed size, raw
+ *
+ * Define ZLIB_NO_USDT to compile the probes out entirely, or
+ * ZLIB_REQUIRE_USDT (CMake ENABLE_ZLIB_USDT) to fail the build when
+ * <sys/sdt.h> is missing instead of silently dropping them.
+ */
+
+#ifndef ZPROBES_H
+#define ZPROBES_H
+
+#if !defined(ZLIB_NO_USDT) && defined(__linux__) && defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    include <sys/sdt.h>
+#    define ZLIB_USDT
+#  endif
+#endif
+
+#if defined(ZLIB_REQUIRE_USDT) && !defined(ZLIB_USDT)
+#  error "ZLIB_REQUIRE_USDT: <sys/sdt.h> not found or probes disabled"
+#endif
+
+#ifdef ZLIB_USDT
+#  define Z_PROBE3(name, a, b, c) DTRACE_PROBE3(zlib, name, a, b, c)
+#  define Z_PROBE4(name, a, b, c, d) DTRACE_PROBE4(zlib, name, a, b, c, d)
+#  define Z_PROBE5(name, a, b, c, d, e) \
+    DTRACE_PROBE5(zlib, name, a, b, c, d, e)
+#else
+#  define Z_PROBE3(name, a, b, c) do {} while (0)
+#  define Z_PROBE4(name, a, b, c, d) do {} while (0)
+#  define Z_PROBE5(name, a, b, c, d, e) do {} while (0)
+#endif
+
+#endif /* ZPROBES_H */
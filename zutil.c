@@ -296,4 +296,50 @@ void ZLIB_INTERNAL zcfree(voidpf opaque, voidpf ptr) {
 
 #endif /* MY_ZCALLOC */
 
+/* Size of the header zallocTracked() puts before each allocation to record
+ * its size: large enough to keep the alignment of the memory returned.
+ */
+#define TRACKED_HEADER 16
+
+voidpf ZEXPORT zallocTracked(voidpf opaque, uInt items, uInt size) {
+    z_alloc_stats *stats = (z_alloc_stats *)opaque;
+    z_size_t bytes = (z_size_t)items * size;
+    unsigned char *buf;
+
+    if (stats == Z_NULL || (size && bytes / size != items) ||
+        bytes > (uInt)-1 - TRACKED_HEADER)
+        return Z_NULL;
+    buf = (unsigned char *)zcalloc(Z_NULL, 1, (unsigned)bytes + TRACKED_HEADER);
+    if (buf == Z_NULL)
+        return Z_NULL;
+    *(z_size_t *)buf = bytes;
+
+    stats->current += bytes;
+    stats->total += bytes;
+    stats->allocs++;
+    if (stats->peak < stats->current)
+        stats->peak = stats->current;
+    return (voidpf)(buf + TRACKED_HEADER);
+}
+
+void ZEXPORT zfreeTracked(voidpf opaque, voidpf address) {
+    z_alloc_stats *stats = (z_alloc_stats *)opaque;
+    unsigned char *buf;
+
+    if (address == Z_NULL)
+        return;
+    buf = (unsigned char *)address - TRACKED_HEADER;
+    if (stats != Z_NULL)
+        stats->current -= *(z_size_t *)buf;
+    zcfree(Z_NULL, (voidpf)buf);
+}
+
+int ZEXPORT zallocGetStats(z_streamp strm, z_alloc_stats *stats) {
+    if (strm == Z_NULL || stats == Z_NULL || strm->opaque == Z_NULL ||
+        strm->zalloc != zallocTracked)
+        return Z_STREAM_ERROR;
+    *stats = *(z_alloc_stats *)strm->opaque;
+    return Z_OK;
+}
+
 #endif /* !Z_SOLO */